@@ -1,10 +1,12 @@
 #pragma once
 
-#include <vector>
+#include "buffer.h"
+
 #include <glm/glm.hpp>
 
 namespace voldata {
 
+// 3D array (x fastest) in an aligned buffer, construction and growth leave new elements uninitialized
 template <typename T> class Buf3D {
 public:
     Buf3D(const glm::uvec3& stride = glm::uvec3(0)) : stride(stride), data(size_t(stride.x) * stride.y * stride.z) {}
@@ -24,6 +26,11 @@ public:
         data.resize(size_t(stride.x) * stride.y * stride.z);
     }
 
+    inline void resize(const glm::uvec3& stride, const T& value) {   // as above, new elements set to value
+        this->stride = stride;
+        data.resize(size_t(stride.x) * stride.y * stride.z, value);
+    }
+
     inline size_t to_idx(const glm::uvec3& coord) const {
         return size_t(coord.z) * stride.x * stride.y + coord.y * stride.x + coord.x;
     }
@@ -34,7 +41,7 @@ public:
 
     // data
     glm::uvec3 stride;
-    std::vector<T> data;
+    Buffer<T> data;
 };
 
 }
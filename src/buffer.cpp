@@ -0,0 +1,59 @@
+#include "buffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace voldata {
+
+static BufferPolicy default_buffer_policy() {
+    BufferPolicy policy;
+    if (const char* env = std::getenv("VOLDATA_HUGE_PAGES"))
+        policy.huge_pages = std::strcmp(env, "0") != 0;
+    if (const char* env = std::getenv("VOLDATA_NUMA"))
+        policy.numa_interleave = std::strcmp(env, "interleave") == 0;
+    return policy;
+}
+
+BufferPolicy& buffer_policy() {
+    static BufferPolicy policy = default_buffer_policy();
+    return policy;
+}
+
+void* allocate_buffer(size_t bytes) {
+    const BufferPolicy& policy = buffer_policy();
+    const bool huge = policy.huge_pages && bytes >= BufferPolicy::HUGE_PAGE_SIZE;
+    size_t alignment = std::max(policy.alignment, alignof(std::max_align_t));
+    if (huge) alignment = std::max(alignment, BufferPolicy::HUGE_PAGE_SIZE);
+#ifdef __linux__
+    // memory policies apply to whole pages
+    if (policy.numa_interleave) alignment = std::max(alignment, size_t(sysconf(_SC_PAGESIZE)));
+#endif
+    // aligned_alloc() requires a multiple of the alignment, also covers the huge pages of the buffer entirely
+    const size_t size = (std::max<size_t>(bytes, 1) + alignment - 1) & ~(alignment - 1);
+    if (size < bytes) throw std::bad_alloc();
+    void* ptr = std::aligned_alloc(alignment, size);
+    if (!ptr) throw std::bad_alloc();
+#ifdef __linux__
+    // hints only, failures (e.g. THP disabled, no NUMA support) keep the default behavior
+    if (huge) madvise(ptr, size, MADV_HUGEPAGE);
+    if (policy.numa_interleave) {
+        const unsigned long nodes = ~0ul;   // all nodes, restricted to the allowed ones by the kernel
+        syscall(SYS_mbind, ptr, size, MPOL_INTERLEAVE, &nodes, sizeof(nodes) * 8, 0);
+    }
+#endif
+    return ptr;
+}
+
+void deallocate_buffer(void* ptr, size_t) {
+    std::free(ptr);
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+namespace voldata {
+
+// allocation policy of large voxel buffers (Buf3D, DenseGrid voxel data, brick caches), applied to every allocation
+// the defaults can be changed via the environment variables VOLDATA_HUGE_PAGES=0|1 and VOLDATA_NUMA=local|interleave
+struct BufferPolicy {
+    static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+    size_t alignment = 64;              // min. alignment in bytes, a power of two (cache line by default)
+    bool huge_pages = true;             // align buffers of at least HUGE_PAGE_SIZE to it and advise transparent huge pages (linux)
+    bool numa_interleave = false;       // interleave pages across NUMA nodes (linux), else pages are placed on first touch
+};
+
+BufferPolicy& buffer_policy();                      // process-wide policy, not synchronized with concurrent allocations
+void* allocate_buffer(size_t bytes);                // aligned allocation w.r.t. buffer_policy(), throws std::bad_alloc
+void deallocate_buffer(void* ptr, size_t bytes);    // release memory of allocate_buffer(), independent of policy changes
+
+// allocator for buffers that are overwritten right after allocation: memory is aligned according to buffer_policy()
+// and elements are default-initialized, so construction or growth via resize(n) leaves trivial types uninitialized
+// (resize(n, value) initializes new elements as usual)
+template <typename T> class BufferAllocator {
+public:
+    using value_type = T;
+
+    BufferAllocator() noexcept {}
+    template <typename U> BufferAllocator(const BufferAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(allocate_buffer(n * sizeof(T))); }
+    void deallocate(T* ptr, size_t n) noexcept { deallocate_buffer(ptr, n * sizeof(T)); }
+
+    template <typename U> void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) { ::new(static_cast<void*>(ptr)) U; }
+    template <typename U, typename... Args> void construct(U* ptr, Args&&... args) { ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...); }
+};
+
+template <typename T, typename U> inline bool operator==(const BufferAllocator<T>&, const BufferAllocator<U>&) { return true; }
+template <typename T, typename U> inline bool operator!=(const BufferAllocator<T>&, const BufferAllocator<U>&) { return false; }
+
+template <typename T> using Buffer = std::vector<T, BufferAllocator<T>>;
+
+}
@@ -0,0 +1,171 @@
+#include "gradient.h"
+
+#include <cfloat>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <execution>
+#include <functional>
+
+namespace voldata {
+
+// ----------------------------------------------
+// row kernels
+
+static const uint32_t BRICK_SIZE = 8;
+
+// dst[x] = src[x+1] - src[x-1], clamped at the borders
+static void diff_row(const float* src, float* dst, uint32_t n) {
+    if (n == 1) { dst[0] = 0.f; return; }
+    dst[0] = src[1] - src[0];
+    for (uint32_t x = 1; x + 1 < n; ++x)
+        dst[x] = src[x + 1] - src[x - 1];
+    dst[n - 1] = src[n - 1] - src[n - 2];
+}
+
+// dst[x] = src[x-1] + 2 src[x] + src[x+1], clamped at the borders
+static void smooth_row(const float* src, float* dst, uint32_t n) {
+    if (n == 1) { dst[0] = 4 * src[0]; return; }
+    dst[0] = 3 * src[0] + src[1];
+    for (uint32_t x = 1; x + 1 < n; ++x)
+        dst[x] = src[x - 1] + 2 * src[x] + src[x + 1];
+    dst[n - 1] = src[n - 2] + 3 * src[n - 1];
+}
+
+// dst[x] += weight * a[x]
+static void accumulate_row(const float* a, float weight, float* dst, uint32_t n) {
+    for (uint32_t x = 0; x < n; ++x)
+        dst[x] += weight * a[x];
+}
+
+// dst[x] += weight * (a[x] - b[x])
+static void accumulate_diff_row(const float* a, const float* b, float weight, float* dst, uint32_t n) {
+    for (uint32_t x = 0; x < n; ++x)
+        dst[x] += weight * (a[x] - b[x]);
+}
+
+// ----------------------------------------------
+// gradient pass
+
+using GradientRowCallback = std::function<void(uint32_t y, uint32_t z, const float* gx, const float* gy, const float* gz)>;
+
+// compute gradient rows of the whole grid, parallel over rows of bricks
+static void for_each_gradient_row(const Grid& grid, GradientStencil stencil, const GradientRowCallback& callback) {
+    const glm::uvec3 extent = grid.index_extent();
+    if (glm::any(glm::equal(extent, glm::uvec3(0)))) return;
+    const glm::uvec3 n_bricks = (extent + BRICK_SIZE - 1u) / BRICK_SIZE;
+    std::vector<uint32_t> brick_rows(size_t(n_bricks.y) * n_bricks.z);
+    std::iota(brick_rows.begin(), brick_rows.end(), 0);
+    std::for_each(std::execution::par_unseq, brick_rows.begin(), brick_rows.end(), [&](uint32_t i) {
+        const uint32_t y0 = (i % n_bricks.y) * BRICK_SIZE, y1 = std::min(y0 + BRICK_SIZE, extent.y);
+        const uint32_t z0 = (i / n_bricks.y) * BRICK_SIZE, z1 = std::min(z0 + BRICK_SIZE, extent.z);
+        // fetch brick row including a one voxel apron, clipped at the grid borders
+        const glm::uvec3 lo = glm::uvec3(0, y0 > 0 ? y0 - 1 : 0, z0 > 0 ? z0 - 1 : 0);
+        const glm::uvec3 hi = glm::uvec3(extent.x, std::min(y1 + 1, extent.y), std::min(z1 + 1, extent.z));
+        const glm::uvec3 size = hi - lo;
+        std::vector<float> region(size_t(size.x) * size.y * size.z);
+        grid.copy_region(lo, hi, region.data());
+        const auto row = [&](uint32_t y, int dy, uint32_t z, int dz) {
+            const uint32_t ry = glm::clamp(int(y) + dy, int(lo.y), int(hi.y) - 1) - lo.y;
+            const uint32_t rz = glm::clamp(int(z) + dz, int(lo.z), int(hi.z) - 1) - lo.z;
+            return region.data() + (size_t(rz) * size.y + ry) * size.x;
+        };
+        // compute gradient row by row
+        const float weights[3] = { 1.f, 2.f, 1.f };
+        std::vector<float> tmp(size.x), gx(size.x), gy(size.x), gz(size.x);
+        for (uint32_t z = z0; z < z1; ++z) {
+            for (uint32_t y = y0; y < y1; ++y) {
+                float scale = 0.5f;
+                if (stencil == SOBEL) {
+                    // x: difference of the yz-smoothed rows
+                    std::fill(tmp.begin(), tmp.end(), 0.f);
+                    for (int dz = -1; dz <= 1; ++dz)
+                        for (int dy = -1; dy <= 1; ++dy)
+                            accumulate_row(row(y, dy, z, dz), weights[dy + 1] * weights[dz + 1], tmp.data(), size.x);
+                    diff_row(tmp.data(), gx.data(), size.x);
+                    // y: x-smoothed sum of z-weighted row differences
+                    std::fill(tmp.begin(), tmp.end(), 0.f);
+                    for (int dz = -1; dz <= 1; ++dz)
+                        accumulate_diff_row(row(y, 1, z, dz), row(y, -1, z, dz), weights[dz + 1], tmp.data(), size.x);
+                    smooth_row(tmp.data(), gy.data(), size.x);
+                    // z: x-smoothed sum of y-weighted row differences
+                    std::fill(tmp.begin(), tmp.end(), 0.f);
+                    for (int dy = -1; dy <= 1; ++dy)
+                        accumulate_diff_row(row(y, dy, z, 1), row(y, dy, z, -1), weights[dy + 1], tmp.data(), size.x);
+                    smooth_row(tmp.data(), gz.data(), size.x);
+                    scale = 1.f / 32.f;
+                } else {
+                    diff_row(row(y, 0, z, 0), gx.data(), size.x);
+                    std::fill(gy.begin(), gy.end(), 0.f);
+                    accumulate_diff_row(row(y, 1, z, 0), row(y, -1, z, 0), 1.f, gy.data(), size.x);
+                    std::fill(gz.begin(), gz.end(), 0.f);
+                    accumulate_diff_row(row(y, 0, z, 1), row(y, 0, z, -1), 1.f, gz.data(), size.x);
+                }
+                for (uint32_t x = 0; x < size.x; ++x) {
+                    gx[x] *= scale;
+                    gy[x] *= scale;
+                    gz[x] *= scale;
+                }
+                callback(y, z, gx.data(), gy.data(), gz.data());
+            }
+        }
+    });
+}
+
+// two gradient passes: find value ranges, then quantize rows into dense grids
+template <size_t N, typename F>
+static std::array<std::shared_ptr<DenseGrid>, N> quantized_gradient_grids(const Grid& grid, GradientStencil stencil, const F& channel) {
+    const glm::uvec3 extent = grid.index_extent();
+    const size_t n_rows = glm::all(glm::greaterThan(extent, glm::uvec3(0))) ? size_t(extent.y) * extent.z : 0;
+    std::vector<std::array<float, N>> minima(n_rows), maxima(n_rows);
+    for_each_gradient_row(grid, stencil, [&](uint32_t y, uint32_t z, const float* gx, const float* gy, const float* gz) {
+        auto& row_min = minima[size_t(z) * extent.y + y];
+        auto& row_max = maxima[size_t(z) * extent.y + y];
+        row_min.fill(FLT_MAX);
+        row_max.fill(-FLT_MAX);
+        for (uint32_t x = 0; x < extent.x; ++x) {
+            const std::array<float, N> values = channel(gx[x], gy[x], gz[x]);
+            for (size_t c = 0; c < N; ++c) {
+                row_min[c] = std::min(row_min[c], values[c]);
+                row_max[c] = std::max(row_max[c], values[c]);
+            }
+        }
+    });
+    // allocate output grids with reduced ranges
+    std::array<std::shared_ptr<DenseGrid>, N> grids;
+    for (size_t c = 0; c < N; ++c) {
+        grids[c] = std::make_shared<DenseGrid>();
+        grids[c]->transform = grid.transform;
+        grids[c]->n_voxels = extent;
+        grids[c]->min_value = n_rows > 0 ? FLT_MAX : 0.f;
+        grids[c]->max_value = n_rows > 0 ? -FLT_MAX : 0.f;
+        for (size_t i = 0; i < n_rows; ++i) {
+            grids[c]->min_value = std::min(grids[c]->min_value, minima[i][c]);
+            grids[c]->max_value = std::max(grids[c]->max_value, maxima[i][c]);
+        }
+        grids[c]->voxel_data.resize(size_t(extent.x) * extent.y * extent.z);
+    }
+    for_each_gradient_row(grid, stencil, [&](uint32_t y, uint32_t z, const float* gx, const float* gy, const float* gz) {
+        const size_t offset = (size_t(z) * extent.y + y) * extent.x;
+        for (uint32_t x = 0; x < extent.x; ++x) {
+            const std::array<float, N> values = channel(gx[x], gy[x], gz[x]);
+            for (size_t c = 0; c < N; ++c)
+                grids[c]->voxel_data[offset + x] = quantize_u8(values[c], grids[c]->min_value, grids[c]->max_value);
+        }
+    });
+    return grids;
+}
+
+std::array<std::shared_ptr<DenseGrid>, 3> gradient_grids(const Grid& grid, GradientStencil stencil) {
+    return quantized_gradient_grids<3>(grid, stencil, [](float gx, float gy, float gz) {
+        return std::array<float, 3>{ gx, gy, gz };
+    });
+}
+
+std::shared_ptr<DenseGrid> gradient_magnitude_grid(const Grid& grid, GradientStencil stencil) {
+    return quantized_gradient_grids<1>(grid, stencil, [](float gx, float gy, float gz) {
+        return std::array<float, 1>{ std::sqrt(gx * gx + gy * gy + gz * gz) };
+    })[0];
+}
+
+}
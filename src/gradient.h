@@ -0,0 +1,18 @@
+#pragma once
+
+#include "grid.h"
+#include "grid_dense.h"
+
+#include <array>
+#include <memory>
+
+namespace voldata {
+
+enum GradientStencil { CENTRAL_DIFFERENCES, SOBEL };
+
+// index-space gradient (clamp-to-edge borders) per component, quantized to 8 bits into grids with the source's extent and transform
+std::array<std::shared_ptr<DenseGrid>, 3> gradient_grids(const Grid& grid, GradientStencil stencil = CENTRAL_DIFFERENCES);
+// index-space gradient magnitude, quantized to 8 bits as above
+std::shared_ptr<DenseGrid> gradient_magnitude_grid(const Grid& grid, GradientStencil stencil = CENTRAL_DIFFERENCES);
+
+}
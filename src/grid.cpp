@@ -1,12 +1,132 @@
 #include "grid.h"
+#include "quantize.h"
 
+#include <array>
+#include <cfloat>
 #include <sstream>
+#include <algorithm>
 #include <glm/gtx/string_cast.hpp>
 
 namespace voldata {
 
+// tile size of the default active block iteration
+static const uint32_t BLOCK_SIZE = 8;
+
+// number of samples gathered at once in the default batched trilinear interpolation
+static const size_t SAMPLE_BATCH_SIZE = 256;
+
 Grid::Grid() : transform(glm::mat4(1)) {}
 
+void Grid::lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const {
+    for (size_t i = 0; i < n; ++i)
+        values[i] = lookup(ipos[i]);
+}
+
+void Grid::copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // fetch region row-wise in batches
+    const glm::uvec3 size = max - min;
+    std::vector<glm::uvec3> positions(size.x);
+    for (uint32_t z = 0; z < size.z; ++z) {
+        for (uint32_t y = 0; y < size.y; ++y) {
+            for (uint32_t x = 0; x < size.x; ++x)
+                positions[x] = min + glm::uvec3(x, y, z);
+            lookup_batch(positions.data(), dst + (size_t(z) * size.y + y) * size.x, size.x);
+        }
+    }
+}
+
+void Grid::copy_region(const glm::uvec3& min, const glm::uvec3& max, uint8_t* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // fetch region slice-wise and quantize
+    const auto [min_value, max_value] = minorant_majorant();
+    const glm::uvec3 size = max - min;
+    std::vector<float> slice(size_t(size.x) * size.y);
+    for (uint32_t z = 0; z < size.z; ++z) {
+        copy_region(glm::uvec3(min.x, min.y, min.z + z), glm::uvec3(max.x, max.y, min.z + z + 1), slice.data());
+        quantize_u8_batch(slice.data(), slice.size(), min_value, max_value, dst + z * slice.size());
+    }
+}
+
+void Grid::for_each_active_block(const BlockCallback& callback) const {
+    const glm::uvec3 extent = index_extent();
+    if (glm::any(glm::equal(extent, glm::uvec3(0)))) return;
+    // bulk read rows of tiles and report tiles exceeding the global minorant
+    const float minorant = minorant_majorant().first;
+    std::vector<float> row;
+    for (uint32_t tz = 0; tz < extent.z; tz += BLOCK_SIZE) {
+        for (uint32_t ty = 0; ty < extent.y; ty += BLOCK_SIZE) {
+            const glm::uvec3 row_min = glm::uvec3(0, ty, tz);
+            const glm::uvec3 row_max = glm::min(glm::uvec3(extent.x, ty + BLOCK_SIZE, tz + BLOCK_SIZE), extent);
+            const glm::uvec3 size = row_max - row_min;
+            row.resize(size_t(size.x) * size.y * size.z);
+            copy_region(row_min, row_max, row.data());
+            for (uint32_t tx = 0; tx < extent.x; tx += BLOCK_SIZE) {
+                const uint32_t tx_end = std::min(tx + BLOCK_SIZE, extent.x);
+                float tile_min = FLT_MAX, tile_max = -FLT_MAX;
+                for (uint32_t z = 0; z < size.z; ++z) {
+                    for (uint32_t y = 0; y < size.y; ++y) {
+                        const float* values = row.data() + (size_t(z) * size.y + y) * size.x;
+                        for (uint32_t x = tx; x < tx_end; ++x) {
+                            tile_min = std::min(tile_min, values[x]);
+                            tile_max = std::max(tile_max, values[x]);
+                        }
+                    }
+                }
+                if (tile_max > minorant)
+                    callback(glm::uvec3(tx, ty, tz), glm::uvec3(tx_end, row_max.y, row_max.z), tile_min, tile_max);
+            }
+        }
+    }
+}
+
+float Grid::sample_trilinear(const glm::vec3& ipos) const {
+    // gather voxel neighborhood (clamped to grid border) with a single batched lookup
+    const glm::vec3 p = ipos - 0.5f;
+    const glm::vec3 base = glm::floor(p), f = p - base;
+    const glm::ivec3 imax = glm::ivec3(index_extent()) - 1;
+    if (glm::any(glm::lessThan(imax, glm::ivec3(0)))) return 0.f;
+    const glm::ivec3 lo = glm::clamp(glm::ivec3(base), glm::ivec3(0), imax), hi = glm::clamp(glm::ivec3(base) + 1, glm::ivec3(0), imax);
+    std::array<glm::uvec3, 8> positions;
+    for (uint32_t i = 0; i < 8; ++i)
+        positions[i] = glm::uvec3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+    std::array<float, 8> v;
+    lookup_batch(positions.data(), v.data(), 8);
+    return trilinear(v, f);
+}
+
+void Grid::sample_trilinear_batch(const glm::vec3* ipos, float* values, size_t n) const {
+    const glm::ivec3 imax = glm::ivec3(index_extent()) - 1;
+    if (glm::any(glm::lessThan(imax, glm::ivec3(0)))) {
+        std::fill(values, values + n, 0.f);
+        return;
+    }
+    std::vector<float> weights(SAMPLE_BATCH_SIZE * 8), taps(SAMPLE_BATCH_SIZE * 8);
+    std::vector<glm::uvec3> positions(SAMPLE_BATCH_SIZE * 8);
+    for (size_t offset = 0; offset < n; offset += SAMPLE_BATCH_SIZE) {
+        const size_t count = std::min(SAMPLE_BATCH_SIZE, n - offset);
+        // setup tap positions (clamped to grid border) and weights
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec3 p = ipos[offset + i] - 0.5f;
+            const glm::vec3 base = glm::floor(p), f = p - base;
+            const glm::ivec3 lo = glm::clamp(glm::ivec3(base), glm::ivec3(0), imax), hi = glm::clamp(glm::ivec3(base) + 1, glm::ivec3(0), imax);
+            for (uint32_t t = 0; t < 8; ++t) {
+                positions[i * 8 + t] = glm::uvec3(t & 1 ? hi.x : lo.x, t & 2 ? hi.y : lo.y, t & 4 ? hi.z : lo.z);
+                weights[i * 8 + t] = (t & 1 ? f.x : 1.f - f.x) * (t & 2 ? f.y : 1.f - f.y) * (t & 4 ? f.z : 1.f - f.z);
+            }
+        }
+        // gather all taps with a single batched lookup
+        lookup_batch(positions.data(), taps.data(), count * 8);
+        // weighted reduction (vectorizable)
+        for (size_t i = 0; i < count; ++i) {
+            float value = 0.f;
+            for (uint32_t t = 0; t < 8; ++t)
+                value += weights[i * 8 + t] * taps[i * 8 + t];
+            values[offset + i] = value;
+        }
+    }
+}
+
 std::string Grid::to_string(const std::string& indent) const {
     std::stringstream out;
     const glm::uvec3 ibb_max = index_extent();
@@ -24,4 +144,21 @@ std::string Grid::to_string(const std::string& indent) const {
 
 std::ostream& operator<<(std::ostream& out, const Grid& grid) { return out << grid.to_string(); }
 
+std::vector<size_t> block_order(const glm::uvec3* ipos, size_t n, uint32_t log2_block) {
+    if (n < 64) return {};
+    // compute block keys (21 bits per axis)
+    std::vector<std::pair<uint64_t, size_t>> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        const glm::uvec3 block = ipos[i] >> log2_block;
+        keys[i] = { (uint64_t(block.z & 0x1FFFFFu) << 42) | (uint64_t(block.y & 0x1FFFFFu) << 21) | uint64_t(block.x & 0x1FFFFFu), i };
+    }
+    // keep coherent batches (e.g. rows) in their given order
+    if (std::is_sorted(keys.begin(), keys.end())) return {};
+    std::sort(keys.begin(), keys.end());
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i)
+        order[i] = keys[i].second;
+    return order;
+}
+
 }
@@ -1,18 +1,31 @@
 #pragma once
 
+#include <cmath>
+#include <array>
+#include <vector>
 #include <memory>
 #include <iostream>
+#include <functional>
 #include <glm/glm.hpp>
 
 namespace voldata {
 
 class Grid {
 public:
+    // callback for active block iteration: index-space bounds [min, max) and (conservative) value range of the block
+    using BlockCallback = std::function<void(const glm::uvec3& min, const glm::uvec3& max, float minorant, float majorant)>;
+
     Grid();
     virtual ~Grid() {}
 
     // grid interface
     virtual float lookup(const glm::uvec3& ipos) const = 0;                 // index-space grid lookup
+    virtual void lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const; // batched index-space grid lookup of n voxels
+    virtual void copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const;   // bulk read of index-space box [min, max) into dst (x fastest)
+    virtual void copy_region(const glm::uvec3& min, const glm::uvec3& max, uint8_t* dst) const; // bulk read as above, quantized to 8 bits w.r.t. minorant_majorant()
+    virtual void for_each_active_block(const BlockCallback& callback) const;  // iterate blocks holding values above the global minorant (8^3 tiles by default)
+    virtual float sample_trilinear(const glm::vec3& ipos) const;            // index-space trilinear interpolation of voxel centers (i + 0.5), clamped to the grid border
+    virtual void sample_trilinear_batch(const glm::vec3* ipos, float* values, size_t n) const;  // batched trilinear interpolation of n index-space positions
     virtual std::pair<float, float> minorant_majorant() const = 0;          // global minorant and majorant
     virtual glm::uvec3 index_extent() const = 0;                            // max of index space voxel AABB, origin always (0, 0, 0)
     virtual size_t num_voxels() const = 0;                                  // number of (active) voxels in this grid
@@ -28,4 +41,24 @@ public:
 
 std::ostream& operator<<(std::ostream& out, const Grid& grid);
 
+// quantize value to 8 bits w.r.t. the given value range (clamped, NaN to 0), see quantize.h for the batched version
+inline uint8_t quantize_u8(float value, float min, float max) {
+    if (!(max > min)) return 0;
+    float t = (value - min) * (255.f / (max - min));
+    t = t > 0.f ? t : 0.f;
+    t = t < 255.f ? t : 255.f;
+    return uint8_t(t + 0.5f);
+}
+
+// trilinear blend of a 2^3 voxel neighborhood (x fastest) with interpolation weights f in [0, 1]^3
+inline float trilinear(const std::array<float, 8>& v, const glm::vec3& f) {
+    const float x00 = glm::mix(v[0], v[1], f.x), x10 = glm::mix(v[2], v[3], f.x);
+    const float x01 = glm::mix(v[4], v[5], f.x), x11 = glm::mix(v[6], v[7], f.x);
+    return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+}
+
+// processing order for batched lookups, grouped by blocks (bricks, leaf nodes) of size 2^log2_block
+// returns an empty vector if the batch is small or already sorted, i.e. the given order should be used
+std::vector<size_t> block_order(const glm::uvec3* ipos, size_t n, uint32_t log2_block);
+
 }
@@ -1,8 +1,13 @@
 #include "grid_brick.h"
+#include "quantize.h"
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <array>
 #include <numeric>
+#include <unordered_map>
 #include <algorithm>
 #include <execution>
 #include <glm/gtx/string_cast.hpp>
@@ -12,11 +17,8 @@ namespace voldata {
 // ----------------------------------------------
 // constants
 
-static const uint32_t BRICK_SIZE = 8;
 static const uint32_t BITS_PER_AXIS = 10;
 static const uint32_t MAX_BRICKS = 1 << BITS_PER_AXIS;
-static const uint32_t VOXELS_PER_BRICK = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
-static const uint32_t NUM_MIPMAPS = 3;
 
 // ----------------------------------------------
 // encoding helpers
@@ -42,92 +44,582 @@ glm::uvec3 decode_ptr(uint32_t data) {
                       (data >> (2 + 0 * BITS_PER_AXIS)) & (MAX_BRICKS - 1));
 }
 
-uint8_t encode_voxel(float value, const glm::vec2& range) {
-    const float value_norm = glm::clamp((value - range.x) / (range.y - range.x), 0.f, 1.f);
-    return uint8_t(std::round(255 * value_norm));
-}
-
 float decode_voxel(uint8_t data, const glm::vec2& range) {
     return range.x + data * (1.f / 255.f) * (range.y - range.x);
 }
 
+uint32_t quantize_levels(float value, float min, float max, uint32_t levels) {
+    // as quantize_u8(), with the given number of levels
+    if (!(max > min)) return 0;
+    float t = (value - min) * (float(levels) / (max - min));
+    t = t > 0.f ? t : 0.f;
+    t = t < float(levels) ? t : float(levels);
+    return uint32_t(t + 0.5f);
+}
+
+uint64_t hash_bytes(const uint8_t* data, size_t n) {
+    // 64bit FNV-1a over 8 byte words
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, std::min<size_t>(8, n - i));
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+uint64_t morton_code(const glm::uvec3& coord) {
+    // interleave 21 bits per axis
+    auto spread = [](uint64_t x) {
+        x &= 0x1FFFFFu;
+        x = (x | x << 32) & 0x1F00000000FFFFull;
+        x = (x | x << 16) & 0x1F0000FF0000FFull;
+        x = (x | x << 8) & 0x100F00F00F00F00Full;
+        x = (x | x << 4) & 0x10C30C30C30C30C3ull;
+        x = (x | x << 2) & 0x1249249249249249ull;
+        return x;
+    };
+    return spread(coord.x) | (spread(coord.y) << 1) | (spread(coord.z) << 2);
+}
+
+// encoded non-empty brick, kept during construction until atlas slots are assigned
+struct EncodedBrick {
+    uint64_t morton;        // slot order
+    uint64_t hash;          // hash of encoded data (deduplicate)
+    size_t data;            // offset of encoded data in the slice buffer
+    uint32_t slice;
+    uint32_t log2_bits;
+    glm::uvec3 brick;
+};
+
+// gather a stored brick including its apron (edge voxels replicated at the grid border) from a buffer holding the dilated brick
+// buffer element (x, y, z) holds the voxel at origin + (x, y, z), with rows of stride_x elements and stride_y rows per slice
+template <uint32_t BRICK_SIZE>
+static void gather_brick(const float* buffer, const glm::ivec3& origin, size_t stride_x, size_t stride_y, const glm::uvec3& brick, uint32_t apron, const glm::uvec3& extent, float* values) {
+    const uint32_t size = BRICK_SIZE + 2 * apron;
+    const glm::ivec3 first = glm::ivec3(brick * BRICK_SIZE) - int(apron), last = glm::ivec3(extent) - 1;
+    for (uint32_t z = 0; z < size; ++z) {
+        for (uint32_t y = 0; y < size; ++y) {
+            const int gz = glm::clamp(first.z + int(z), 0, last.z), gy = glm::clamp(first.y + int(y), 0, last.y);
+            const float* row = buffer + (size_t(gz - origin.z) * stride_y + (gy - origin.y)) * stride_x;
+            float* dst = values + (z * size + y) * size;
+            std::copy_n(row + brick.x * BRICK_SIZE - origin.x, BRICK_SIZE, dst + apron);
+            if (apron == 0) continue;
+            dst[0] = row[std::max(first.x, 0) - origin.x];
+            dst[size - 1] = row[std::min(first.x + int(size) - 1, last.x) - origin.x];
+        }
+    }
+}
+
+// brick range, collapsed to the minorant (empty brick) if the majorant is below the sparsity threshold
+inline uint32_t encode_sparse_range(float local_min, float local_max, float sparsity_threshold) {
+    return local_max < sparsity_threshold ? encode_range(local_min, local_min) : encode_range(local_min, local_max);
+}
+
 inline glm::uvec3 div_round_up(const glm::uvec3& num, const glm::uvec3& denom) {
     return glm::ceil(glm::vec3(num) / glm::vec3(denom));
 }
 
-BrickGrid::BrickGrid() : Grid(), n_bricks(0), min_maj({0, 0}), brick_counter(0) {}
+template <uint32_t LOG2_BRICK_SIZE>
+BrickGridT<LOG2_BRICK_SIZE>::BrickGridT() : Grid(), n_bricks(0), pointer_mode(PACKED), min_maj({0, 0}), brick_counter(0), active_counter(0), unit_counter(0), tolerance(0), apron(0), dilation(2), sparsity_threshold(-FLT_MAX), slot_refs_built(false) { select_lookup(); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+BrickGridT<LOG2_BRICK_SIZE>::BrickGridT(const Grid& grid) : BrickGridT(grid, Options()) {}
 
-BrickGrid::BrickGrid(const Grid& grid) :
+template <uint32_t LOG2_BRICK_SIZE>
+BrickGridT<LOG2_BRICK_SIZE>::BrickGridT(const Grid& grid, const Options& options) :
     Grid(grid),
-    n_bricks(div_round_up(div_round_up(grid.index_extent(), glm::uvec3(BRICK_SIZE)), glm::uvec3(1u << NUM_MIPMAPS)) * 1u << NUM_MIPMAPS),
-    min_maj(grid.minorant_majorant())
+    n_bricks(div_round_up(grid.index_extent(), glm::uvec3(BRICK_SIZE))),
+    pointer_mode(options.pointer_mode),
+    min_maj(grid.minorant_majorant()),
+    tolerance(options.tolerance),
+    apron(options.apron ? 1 : 0),
+    dilation(std::max(options.dilation, apron)),
+    sparsity_threshold(options.sparsity_threshold),
+    slot_refs_built(false)
 {
+    // select pointer encoding, AUTO only selects variable bit depth if offsets hold the worst case of 8 bits per voxel (and without apron)
+    const size_t n_bricks_total = size_t(n_bricks.x) * n_bricks.y * n_bricks.z;
+    const bool fits_packed = glm::all(glm::lessThan(n_bricks, glm::uvec3(MAX_BRICKS)));
+    const bool fits_variable = n_bricks_total * 8 <= (size_t(1) << 30);
+    if (pointer_mode == AUTO)
+        pointer_mode = options.tolerance > 0.f && fits_variable && !apron ? VARIABLE : fits_packed ? PACKED : WIDE;
+    if (pointer_mode == VARIABLE && apron)
+        throw std::runtime_error("apron is not supported for variable bit depth");
+    if (pointer_mode == PACKED && !fits_packed)
+        throw std::runtime_error(std::string("exceeded max brick count of ") + std::to_string(MAX_BRICKS) + " per axis for packed pointers");
+    if (pointer_mode == WIDE && n_bricks_total > size_t(UINT32_MAX))
+        throw std::runtime_error("exceeded max brick count of " + std::to_string(UINT32_MAX) + " for wide pointers");
+
     // allocate buffers
-    if (glm::any(glm::greaterThanEqual(n_bricks, glm::uvec3(MAX_BRICKS))))
-        throw std::runtime_error(std::string("exceeded max brick count of ") + std::to_string(MAX_BRICKS));
     indirection.resize(n_bricks);
     range.resize(n_bricks);
-    atlas.resize(n_bricks * BRICK_SIZE);
 
-    // construct brick grid
-    brick_counter = 0;
+    // encode bricks, each slice of bricks sweeps its brick rows along y with a scratch tile
+    // holding the dilated row, so source voxels are fetched once per slice (plus the dilation in z)
+    // encoded data is kept per slice until atlas slots are assigned
+    const uint32_t DILATION = dilation, TILE = BRICK_SIZE + 2 * DILATION;
+    const size_t tile_w = size_t(n_bricks.x) * BRICK_SIZE + DILATION;
+    std::vector<std::vector<EncodedBrick>> slice_bricks(n_bricks.z);
+    std::vector<std::vector<uint8_t>> slice_data(n_bricks.z);
     std::vector<int> slices(n_bricks.z);
     std::iota(slices.begin(), slices.end(), 0);
     std::for_each(std::execution::par_unseq, slices.begin(), slices.end(), [&](int bz) {
-        for (size_t by = 0; by < n_bricks.y; ++by) {
+        // tile rows start at (0, by * BRICK_SIZE - DILATION, bz * BRICK_SIZE - DILATION), rows outside the lower grid border stay unused
+        std::vector<float> tile(tile_w * TILE * TILE), column_min(tile_w), column_max(tile_w);
+        const uint32_t tile_z0 = DILATION - std::min(DILATION, bz * BRICK_SIZE);
+        for (uint32_t by = 0; by < n_bricks.y; ++by) {
+            // keep the rows overlapping the previous brick row and fetch the remaining ones
+            const uint32_t tile_y0 = DILATION - std::min(DILATION, by * BRICK_SIZE), first_row = by == 0 ? DILATION : 2 * DILATION;
+            for (uint32_t tz = tile_z0; tz < TILE; ++tz) {
+                float* slice = tile.data() + size_t(tz) * TILE * tile_w;
+                if (by > 0) std::copy(slice + BRICK_SIZE * tile_w, slice + TILE * tile_w, slice);
+                const uint32_t z = bz * BRICK_SIZE + tz - DILATION, y = by * BRICK_SIZE + first_row - DILATION;
+                grid.copy_region(glm::uvec3(0, y, z), glm::uvec3(tile_w, by * BRICK_SIZE + BRICK_SIZE + DILATION, z + 1), slice + first_row * tile_w);
+            }
+            // reduce the dilated rows (clipped at the lower grid border) to per-column ranges, NaNs are ignored
+            std::fill(column_min.begin(), column_min.end(), FLT_MAX);
+            std::fill(column_max.begin(), column_max.end(), -FLT_MAX);
+            for (uint32_t tz = tile_z0; tz < TILE; ++tz) {
+                for (uint32_t ty = tile_y0; ty < TILE; ++ty) {
+                    const float* row = tile.data() + (size_t(tz) * TILE + ty) * tile_w;
+                    for (size_t x = 0; x < tile_w; ++x) {
+                        column_min[x] = row[x] < column_min[x] ? row[x] : column_min[x];
+                        column_max[x] = row[x] > column_max[x] ? row[x] : column_max[x];
+                    }
+                }
+            }
             for (size_t bx = 0; bx < n_bricks.x; ++bx) {
                 // store empty brick
                 const glm::uvec3 brick = glm::uvec3(bx, by, bz);
                 indirection[brick] = 0;
                 // compute local range over dilated brick
+                const size_t tile_x0 = bx * BRICK_SIZE - std::min<size_t>(DILATION, bx * BRICK_SIZE), tile_x1 = bx * BRICK_SIZE + BRICK_SIZE + DILATION;
                 float local_min = FLT_MAX, local_max = -FLT_MAX;
-                for (int z = -2; z < int(BRICK_SIZE) + 2; ++z) {
-                    for (int y = -2; y < int(BRICK_SIZE) + 2; ++y) {
-                        for (int x = -2; x < int(BRICK_SIZE) + 2; ++x) {
-                            const float value = grid.lookup(glm::uvec3(glm::ivec3(brick * BRICK_SIZE) + glm::ivec3(x, y, z)));
-                            local_min = std::min(local_min, value);
-                            local_max = std::max(local_max, value);
-                        }
-                    }
+                for (size_t x = tile_x0; x < tile_x1; ++x) {
+                    local_min = std::min(local_min, column_min[x]);
+                    local_max = std::max(local_max, column_max[x]);
                 }
-                // store range but skip pointer and atlas for empty bricks
-                range[brick] = encode_range(local_min, local_max);
-                if (local_max == local_min) continue;
-                // allocate memory for brick
-                const size_t id = brick_counter.fetch_add(1, std::memory_order_relaxed);
-                const glm::uvec3 ptr = indirection.to_coord(id);
-                // store pointer (offset)
-                indirection[brick] = encode_ptr(ptr);
-                // store brick data
+                // store range but skip pointer and atlas for empty bricks (compared at range precision)
+                range[brick] = encode_sparse_range(local_min, local_max, sparsity_threshold);
                 const glm::vec2 local_range = decode_range(range[brick]);
-                for (size_t z = 0; z < BRICK_SIZE; ++z)
-                    for (size_t y = 0; y < BRICK_SIZE; ++y)
-                        for (size_t x = 0; x < BRICK_SIZE; ++x)
-                            atlas[ptr * BRICK_SIZE + glm::uvec3(x, y, z)] = encode_voxel(grid.lookup(brick * BRICK_SIZE + glm::uvec3(x, y, z)), local_range);
+                if (local_range.x == local_range.y) continue;
+                // gather inner brick (and apron) and encode in one batch
+                std::array<float, MAX_STORED_VOXELS> values;
+                std::array<uint8_t, MAX_STORED_VOXELS> encoded;
+                const glm::ivec3 tile_origin = glm::ivec3(0, by * BRICK_SIZE, bz * BRICK_SIZE) - glm::ivec3(0, DILATION, DILATION);
+                gather_brick<BRICK_SIZE>(tile.data(), tile_origin, tile_w, TILE, brick, apron, index_extent(), values.data());
+                const uint32_t log2_bits = encode_brick(values.data(), local_range, encoded.data());
+                const size_t n_bytes = encoded_bytes(log2_bits);
+                const uint64_t hash = options.deduplicate ? hash_bytes(encoded.data(), n_bytes) ^ log2_bits : 0;
+                slice_bricks[bz].push_back(EncodedBrick{ morton_code(brick), hash, slice_data[bz].size(), uint32_t(bz), log2_bits, brick });
+                slice_data[bz].insert(slice_data[bz].end(), encoded.begin(), encoded.begin() + n_bytes);
             }
         }
     });
 
-    // prune atlas in z dimension
-    atlas.prune(BRICK_SIZE * std::round(std::ceil(brick_counter / float(n_bricks.x * n_bricks.y))));
+    // order non-empty bricks along a Morton curve for deterministic and spatially coherent atlas slots
+    std::vector<EncodedBrick> bricks;
+    for (auto& list : slice_bricks) {
+        bricks.insert(bricks.end(), list.begin(), list.end());
+        std::vector<EncodedBrick>().swap(list);
+    }
+    std::sort(std::execution::par_unseq, bricks.begin(), bricks.end(), [](const EncodedBrick& a, const EncodedBrick& b) { return a.morton < b.morton; });
+    auto encoded_data = [&](const EncodedBrick& brick) { return slice_data[brick.slice].data() + brick.data; };
+
+    // assign slots in order: exclusive prefix sum over slot sizes, or the first bit-identical brick when deduplicating
+    std::vector<size_t> slots(bricks.size());
+    std::vector<size_t> owner(bricks.size());
+    std::iota(owner.begin(), owner.end(), 0);
+    size_t n_slots = bricks.size(), n_units = 0;
+    if (!options.deduplicate) {
+        std::transform_exclusive_scan(std::execution::par_unseq, bricks.begin(), bricks.end(), slots.begin(), size_t(0), std::plus<size_t>(),
+            [&](const EncodedBrick& brick) { return pointer_mode == VARIABLE ? size_t(1) << brick.log2_bits : size_t(1); });
+        n_units = bricks.empty() ? 0 : slots.back() + (size_t(1) << bricks.back().log2_bits);
+    } else {
+        std::unordered_multimap<uint64_t, size_t> first;    // hash -> index of brick owning the slot
+        n_slots = 0;
+        for (size_t i = 0; i < bricks.size(); ++i) {
+            const auto [begin, end] = first.equal_range(bricks[i].hash);
+            const auto match = std::find_if(begin, end, [&](const auto& candidate) {
+                const EncodedBrick& other = bricks[candidate.second];
+                return other.log2_bits == bricks[i].log2_bits && std::memcmp(encoded_data(other), encoded_data(bricks[i]), encoded_bytes(other.log2_bits)) == 0;
+            });
+            if (match != end) {
+                owner[i] = match->second;
+                continue;
+            }
+            first.emplace(bricks[i].hash, i);
+            slots[i] = pointer_mode == VARIABLE ? n_units : n_slots;
+            n_units += size_t(1) << bricks[i].log2_bits;
+            n_slots++;
+        }
+    }
+    if (pointer_mode == VARIABLE && n_units > (size_t(1) << 30))
+        throw std::runtime_error("exceeded atlas capacity for variable bit depth");
+    brick_counter = n_slots;
+    active_counter = bricks.size();
+    unit_counter = pointer_mode == VARIABLE ? n_units : 0;
+
+    // allocate atlas for the assigned slots (at least one, referenced by empty bricks), rows hold at least one slot for zero-extent sources
+    const uint32_t row = std::max(n_bricks.x, 1u), slab = std::max(n_bricks.x * n_bricks.y, 1u);
+    if (pointer_mode == PACKED)
+        atlas.resize(glm::uvec3(row, slab / row, (std::max<size_t>(n_slots, 1) + slab - 1) / slab) * stored_size());
+    else if (pointer_mode == WIDE)
+        atlas.resize(glm::uvec3(encoded_bytes(3), row, (std::max<size_t>(n_slots, 1) + row - 1) / row));
+    else
+        atlas.resize(glm::uvec3(VOXELS_PER_BRICK / 8, 8 * row, (std::max<size_t>(n_units, 1) + 8 * row - 1) / (8 * row)));
+    // the atlas is allocated uninitialized, clear what is not covered by stored bricks (the partially used last slab of PACKED atlases)
+    const size_t covered = pointer_mode == PACKED ? atlas.data.size() - size_t(atlas.size().x) * atlas.size().y * stored_size() :
+                           pointer_mode == WIDE ? n_slots * encoded_bytes(3) : n_units * (VOXELS_PER_BRICK / 8);
+    std::fill(atlas.data.begin() + covered, atlas.data.end(), 0);
+
+    // store pointers and brick data
+    std::vector<size_t> order(bricks.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto to_ptr = [&](size_t i) {
+        if (pointer_mode == VARIABLE) return uint32_t(slots[i] << 2) | bricks[i].log2_bits;
+        return pointer_mode == PACKED ? encode_ptr(indirection.to_coord(slots[i])) : uint32_t(slots[i]);
+    };
+    std::for_each(std::execution::par_unseq, order.begin(), order.end(), [&](size_t i) {
+        indirection[bricks[i].brick] = to_ptr(owner[i]);
+        if (owner[i] == i) store_brick(indirection[bricks[i].brick], encoded_data(bricks[i]));
+    });
 
     // generate min/max mipmaps of range texture
-    range_mipmaps.resize(NUM_MIPMAPS);
-    for (uint32_t i = 0; i < NUM_MIPMAPS; ++i) {
-        const glm::uvec3 mip_size = glm::uvec3(n_bricks / (1u << (i + 1u)));
-        range_mipmaps[i].resize(mip_size);
+    build_mipmaps();
+    select_lookup();
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+BrickGridT<LOG2_BRICK_SIZE>::BrickGridT(const std::shared_ptr<Grid>& grid) : BrickGridT(*grid) {}
+
+template <uint32_t LOG2_BRICK_SIZE>
+BrickGridT<LOG2_BRICK_SIZE>::BrickGridT(const std::shared_ptr<Grid>& grid, const Options& options) : BrickGridT(*grid, options) {}
+
+template <uint32_t LOG2_BRICK_SIZE>
+BrickGridT<LOG2_BRICK_SIZE>::~BrickGridT() {}
+
+template <uint32_t LOG2_BRICK_SIZE>
+float BrickGridT<LOG2_BRICK_SIZE>::lookup(const glm::uvec3& ipos) const { return (this->*lookup_fn)(ipos); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const { (this->*lookup_batch_fn)(ipos, values, n); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+template <bool PACKED_LAYOUT>
+float BrickGridT<LOG2_BRICK_SIZE>::lookup_voxel(const glm::uvec3& ipos) const {
+    const glm::uvec3 brick = ipos >> LOG2_BRICK_SIZE;
+    const uint32_t ptr = indirection[brick];
+    const glm::vec2 minmax = decode_range(range[brick]);
+    if constexpr (PACKED_LAYOUT)
+        return decode_voxel(atlas[(decode_ptr(ptr) << LOG2_BRICK_SIZE) | (ipos & (BRICK_SIZE - 1u))], minmax);
+    else
+        return fetch_voxel(ptr, brick_offset(ptr), minmax, ipos & (BRICK_SIZE - 1u));
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+template <bool PACKED_LAYOUT>
+void BrickGridT<LOG2_BRICK_SIZE>::lookup_voxels(const glm::uvec3* ipos, float* values, size_t n) const {
+    // process queries grouped by brick and reuse decoded pointer and range of the previous query
+    const std::vector<size_t> order = block_order(ipos, n, LOG2_BRICK_SIZE);
+    size_t last = SIZE_MAX, offset = 0;
+    uint32_t ptr = 0;
+    glm::uvec3 origin;
+    glm::vec2 minmax;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t j = order.empty() ? i : order[i];
+        const size_t brick = indirection.to_idx(ipos[j] >> LOG2_BRICK_SIZE);
+        if (brick != last) {
+            ptr = indirection.data[brick];
+            if constexpr (PACKED_LAYOUT) origin = decode_ptr(ptr) << LOG2_BRICK_SIZE;
+            else offset = brick_offset(ptr);
+            minmax = decode_range(range.data[brick]);
+            last = brick;
+        }
+        if constexpr (PACKED_LAYOUT)
+            values[j] = decode_voxel(atlas[origin | (ipos[j] & (BRICK_SIZE - 1u))], minmax);
+        else
+            values[j] = fetch_voxel(ptr, offset, minmax, ipos[j] & (BRICK_SIZE - 1u));
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::select_lookup() {
+    const bool packed = pointer_mode == PACKED && apron == 0;
+    lookup_fn = packed ? &BrickGridT::lookup_voxel<true> : &BrickGridT::lookup_voxel<false>;
+    lookup_batch_fn = packed ? &BrickGridT::lookup_voxels<true> : &BrickGridT::lookup_voxels<false>;
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // decode brick-by-brick, voxels outside of the grid are zero
+    const glm::uvec3 size = max - min;
+    const glm::uvec3 brick_min = min / BRICK_SIZE, brick_max = (max - 1u) / BRICK_SIZE;
+    for (uint32_t bz = brick_min.z; bz <= brick_max.z; ++bz) {
+        for (uint32_t by = brick_min.y; by <= brick_max.y; ++by) {
+            for (uint32_t bx = brick_min.x; bx <= brick_max.x; ++bx) {
+                const glm::uvec3 brick = glm::uvec3(bx, by, bz);
+                const glm::uvec3 lo = glm::max(brick * BRICK_SIZE, min), hi = glm::min(brick * BRICK_SIZE + BRICK_SIZE, max);
+                const bool inside = glm::all(glm::lessThan(brick, n_bricks));
+                const uint32_t ptr = inside ? indirection[brick] : 0;
+                const size_t offset = inside ? brick_offset(ptr) : 0;
+                const glm::vec2 minmax = inside ? decode_range(range[brick]) : glm::vec2(0);
+                for (uint32_t z = lo.z; z < hi.z; ++z) {
+                    for (uint32_t y = lo.y; y < hi.y; ++y) {
+                        float* row = dst + (size_t(z - min.z) * size.y + y - min.y) * size.x;
+                        if (!inside) {
+                            std::fill(row + lo.x - min.x, row + hi.x - min.x, 0.f);
+                            continue;
+                        }
+                        if (pointer_mode == VARIABLE) {
+                            for (uint32_t x = lo.x; x < hi.x; ++x)
+                                row[x - min.x] = fetch_voxel(ptr, offset, minmax, glm::uvec3(x, y, z) % BRICK_SIZE);
+                            continue;
+                        }
+                        const uint8_t* src = atlas.data.data() + offset + voxel_offset(glm::uvec3(0, y % BRICK_SIZE, z % BRICK_SIZE));
+                        for (uint32_t x = lo.x; x < hi.x; ++x)
+                            row[x - min.x] = decode_voxel(src[x % BRICK_SIZE], minmax);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::for_each_active_block(const BlockCallback& callback) const {
+    // report bricks with (dilated) ranges exceeding the global minorant, compared at range precision
+    const float minorant = decode_range(encode_range(min_maj.first, min_maj.first)).x;
+    for (uint32_t bz = 0; bz < n_bricks.z; ++bz) {
+        for (uint32_t by = 0; by < n_bricks.y; ++by) {
+            for (uint32_t bx = 0; bx < n_bricks.x; ++bx) {
+                const glm::uvec3 brick = glm::uvec3(bx, by, bz);
+                const glm::vec2 minmax = decode_range(range[brick]);
+                if (minmax.y > minorant)
+                    callback(brick * BRICK_SIZE, brick * BRICK_SIZE + BRICK_SIZE, minmax.x, minmax.y);
+            }
+        }
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+float BrickGridT<LOG2_BRICK_SIZE>::sample_trilinear(const glm::vec3& ipos) const {
+    if (apron == 0) return Grid::sample_trilinear(ipos);
+    // the voxel neighborhood lies within a single stored brick, the apron replicates voxels at the grid border
+    glm::uvec3 brick;
+    glm::vec3 f;
+    const glm::uvec3 stored = apron_corner(ipos, brick, f);
+    const glm::vec2 minmax = decode_range(range[brick]);
+    if (minmax.x == minmax.y) return minmax.x;
+    const uint8_t* data = atlas.data.data() + brick_offset(indirection[brick]) + stored_offset(stored);
+    return decode_trilinear(data, stored_offset(glm::uvec3(0, 1, 0)), stored_offset(glm::uvec3(0, 0, 1)), minmax, f);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::sample_trilinear_batch(const glm::vec3* ipos, float* values, size_t n) const {
+    if (apron == 0) return Grid::sample_trilinear_batch(ipos, values, n);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = sample_trilinear(ipos[i]);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+typename BrickGridT<LOG2_BRICK_SIZE>::RayIterator BrickGridT<LOG2_BRICK_SIZE>::traverse(const glm::vec3& ipos, const glm::vec3& idir, float t_min, float t_max, float threshold) const {
+    return RayIterator(*this, ipos, idir, t_min, t_max, threshold);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::pair<float, float> BrickGridT<LOG2_BRICK_SIZE>::minorant_majorant() const { return min_maj; }
+
+template <uint32_t LOG2_BRICK_SIZE>
+static void range_query_cell(const BrickGridT<LOG2_BRICK_SIZE>& grid, uint32_t level, const glm::uvec3& cell, const glm::uvec3& lo, const glm::uvec3& hi, glm::vec2& result) {
+    // cell covers bricks [cell << level, (cell + 1) << level)
+    const glm::vec2 minmax = decode_range(level == 0 ? grid.range[cell] : grid.range_mipmaps[level - 1][cell]);
+    const glm::uvec3 cell_min = cell << level, cell_max = (cell + 1u) << level;
+    const bool contained = glm::all(glm::greaterThanEqual(cell_min, lo)) && glm::all(glm::lessThanEqual(cell_max, hi));
+    if (level == 0 || contained) {
+        result = glm::vec2(std::min(result.x, minmax.x), std::max(result.y, minmax.y));
+        return;
+    }
+    // no need to descend if the cell bounds cannot widen the result
+    if (minmax.x >= result.x && minmax.y <= result.y) return;
+    for (uint32_t z = 0; z < 2; ++z) {
+        for (uint32_t y = 0; y < 2; ++y) {
+            for (uint32_t x = 0; x < 2; ++x) {
+                const glm::uvec3 child = 2u * cell + glm::uvec3(x, y, z);
+                const glm::uvec3 child_min = child << (level - 1), child_max = (child + 1u) << (level - 1);
+                if (glm::all(glm::lessThan(glm::max(child_min, lo), glm::min(child_max, hi))))
+                    range_query_cell(grid, level - 1, child, lo, hi, result);
+            }
+        }
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::pair<float, float> BrickGridT<LOG2_BRICK_SIZE>::range_query(const glm::uvec3& min, const glm::uvec3& max) const {
+    const glm::uvec3 lo = glm::min(min, index_extent()), hi = glm::min(max, index_extent());
+    if (glm::any(glm::lessThanEqual(hi, lo))) return { 0.f, 0.f };
+    // touched bricks, resolved top-down through the mipmaps and refined only along the query border
+    const glm::uvec3 brick_lo = lo / BRICK_SIZE, brick_hi = (hi - 1u) / BRICK_SIZE + 1u;
+    const uint32_t level = range_mipmaps.size();
+    const glm::uvec3 cell_lo = brick_lo >> level, cell_hi = ((brick_hi - 1u) >> level) + 1u;
+    glm::vec2 result = glm::vec2(FLT_MAX, -FLT_MAX);
+    for (uint32_t z = cell_lo.z; z < cell_hi.z; ++z)
+        for (uint32_t y = cell_lo.y; y < cell_hi.y; ++y)
+            for (uint32_t x = cell_lo.x; x < cell_hi.x; ++x)
+                range_query_cell(*this, level, glm::uvec3(x, y, z), brick_lo, brick_hi, result);
+    return { result.x, result.y };
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::pair<float, float> BrickGridT<LOG2_BRICK_SIZE>::range_query(const glm::vec3& min, const glm::vec3& max) const {
+    // voxel i covers [i, i+1), round outwards
+    const glm::vec3 extent = glm::vec3(index_extent());
+    const glm::uvec3 lo = glm::uvec3(glm::clamp(glm::floor(min), glm::vec3(0), extent));
+    const glm::uvec3 hi = glm::uvec3(glm::clamp(glm::floor(max) + 1.f, glm::vec3(0), extent));
+    return range_query(lo, hi);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+glm::uvec3 BrickGridT<LOG2_BRICK_SIZE>::index_extent() const { return n_bricks * BRICK_SIZE; }
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t BrickGridT<LOG2_BRICK_SIZE>::num_voxels() const { return active_counter * VOXELS_PER_BRICK; }
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t BrickGridT<LOG2_BRICK_SIZE>::size_bytes() const {
+    const size_t dense_bricks = n_bricks.x * n_bricks.y * n_bricks.z;
+    const size_t size_indirection = sizeof(uint32_t) * dense_bricks;
+    const size_t size_range = sizeof(uint32_t) * dense_bricks;
+    const size_t size_atlas = sizeof(uint8_t) * (pointer_mode == VARIABLE ? atlas.data.size() : brick_counter * encoded_bytes(3));
+    size_t size_mipmaps = 0;
+    for (const auto& mip : range_mipmaps)
+        size_mipmaps += sizeof(uint32_t) * mip.stride.x * mip.stride.y * mip.stride.z;
+    return size_indirection + size_range + size_atlas + size_mipmaps;
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t BrickGridT<LOG2_BRICK_SIZE>::brick_offset(uint32_t ptr) const {
+    if (pointer_mode == WIDE) return size_t(ptr) * encoded_bytes(3);
+    if (pointer_mode == VARIABLE) return size_t(ptr >> 2) * (VOXELS_PER_BRICK / 8);
+    return atlas.to_idx(decode_ptr(ptr) * stored_size());
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t BrickGridT<LOG2_BRICK_SIZE>::voxel_offset(const glm::uvec3& voxel) const {
+    if (pointer_mode != PACKED && apron == 0) return (((voxel.z << LOG2_BRICK_SIZE) | voxel.y) << LOG2_BRICK_SIZE) | voxel.x;
+    return stored_offset(voxel + apron);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t BrickGridT<LOG2_BRICK_SIZE>::stored_offset(const glm::uvec3& stored) const {
+    if (pointer_mode == PACKED) return (size_t(stored.z) * atlas.stride.y + stored.y) * atlas.stride.x + stored.x;
+    return (size_t(stored.z) * stored_size() + stored.y) * stored_size() + stored.x;
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t BrickGridT<LOG2_BRICK_SIZE>::encoded_bytes(uint32_t log2_bits) const {
+    if (pointer_mode == VARIABLE) return VOXELS_PER_BRICK >> (3 - log2_bits);
+    return size_t(stored_size()) * stored_size() * stored_size();
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+float BrickGridT<LOG2_BRICK_SIZE>::fetch_voxel(uint32_t ptr, size_t offset, const glm::vec2& range, const glm::uvec3& voxel) const {
+    if (pointer_mode != VARIABLE) return decode_voxel(atlas.data[offset + voxel_offset(voxel)], range);
+    // bit-packed voxel, little endian within bytes
+    const uint32_t log2_bits = ptr & 3u, levels = (1u << (1u << log2_bits)) - 1u;
+    const size_t bit = voxel_offset(voxel) << log2_bits;
+    const uint32_t data = (atlas.data[offset + (bit >> 3)] >> (bit & 7u)) & levels;
+    return range.x + data * (1.f / levels) * (range.y - range.x);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+glm::uvec3 BrickGridT<LOG2_BRICK_SIZE>::apron_corner(const glm::vec3& ipos, glm::uvec3& brick, glm::vec3& f) const {
+    const glm::vec3 p = ipos - 0.5f;
+    const glm::vec3 base = glm::floor(p);
+    const glm::ivec3 corner = glm::clamp(glm::ivec3(base), glm::ivec3(-1), glm::ivec3(index_extent()) - 1);
+    brick = glm::min(glm::uvec3(glm::max(corner, 0)) >> LOG2_BRICK_SIZE, n_bricks - 1u);
+    f = p - base;
+    return glm::uvec3(corner - glm::ivec3(brick * BRICK_SIZE) + 1);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+float BrickGridT<LOG2_BRICK_SIZE>::decode_trilinear(const uint8_t* data, size_t dy, size_t dz, const glm::vec2& range, const glm::vec3& f) {
+    std::array<float, 8> v;
+    for (uint32_t i = 0; i < 8; ++i)
+        v[i] = decode_voxel(data[(i & 1 ? 1 : 0) + (i & 2 ? dy : 0) + (i & 4 ? dz : 0)], range);
+    return trilinear(v, f);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+uint32_t BrickGridT<LOG2_BRICK_SIZE>::encode_brick(const float* values, const glm::vec2& range, uint8_t* encoded) const {
+    quantize_u8_batch(values, encoded_bytes(3), range.x, range.y, encoded);
+    if (pointer_mode != VARIABLE) return 3;
+    // select the lowest bit depth within the error bound and bit-pack the brick (little endian within bytes)
+    const float bound = std::max(tolerance, 0.5f / 255.f * (range.y - range.x));
+    for (uint32_t log2_bits = 0; log2_bits < 3; ++log2_bits) {
+        const uint32_t levels = (1u << (1u << log2_bits)) - 1u;
+        bool within = true;
+        for (uint32_t i = 0; i < VOXELS_PER_BRICK && within; ++i) {
+            const float decoded = range.x + quantize_levels(values[i], range.x, range.y, levels) * (1.f / levels) * (range.y - range.x);
+            within = !(std::abs(decoded - values[i]) > bound);
+        }
+        if (!within) continue;
+        std::fill(encoded, encoded + VOXELS_PER_BRICK, 0);
+        for (uint32_t i = 0; i < VOXELS_PER_BRICK; ++i) {
+            const uint32_t bit = i << log2_bits;
+            encoded[bit >> 3] |= quantize_levels(values[i], range.x, range.y, levels) << (bit & 7u);
+        }
+        return log2_bits;
+    }
+    return 3;
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::store_brick(uint32_t ptr, const uint8_t* encoded) {
+    // row-wise unless bit-packed
+    uint8_t* dst = atlas.data.data() + brick_offset(ptr);
+    if (pointer_mode == VARIABLE) {
+        std::copy_n(encoded, encoded_bytes(ptr & 3u), dst);
+        return;
+    }
+    const uint32_t size = stored_size();
+    for (uint32_t z = 0; z < size; ++z)
+        for (uint32_t y = 0; y < size; ++y)
+            std::copy_n(encoded + (z * size + y) * size, size, dst + stored_offset(glm::uvec3(0, y, z)));
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::build_mipmaps() {
+    // halve (rounding up) until a single cell remains, so cell c of level i covers bricks [c << i, (c + 1) << i)
+    range_mipmaps.clear();
+    for (glm::uvec3 size = n_bricks; glm::any(glm::greaterThan(size, glm::uvec3(1)));) {
+        size = (size + 1u) / 2u;
+        range_mipmaps.emplace_back(size);
+    }
+    update_mipmaps(glm::uvec3(0), n_bricks);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::update_mipmaps(const glm::uvec3& brick_min, const glm::uvec3& brick_max) {
+    for (uint32_t i = 0; i < range_mipmaps.size(); ++i) {
+        const glm::uvec3 cell_min = brick_min >> (i + 1u), cell_max = glm::min(((brick_max - 1u) >> (i + 1u)) + 1u, range_mipmaps[i].size());
         auto& source = i == 0 ? range : range_mipmaps[i - 1];
-        slices.resize(mip_size.z);
-        std::iota(slices.begin(), slices.end(), 0);
+        std::vector<int> slices(cell_max.z - cell_min.z);
+        std::iota(slices.begin(), slices.end(), cell_min.z);
         std::for_each(std::execution::par_unseq, slices.begin(), slices.end(), [&](int bz) {
-            for (size_t by = 0; by < mip_size.y; ++by) {
-                for (size_t bx = 0; bx < mip_size.x; ++bx) {
+            for (size_t by = cell_min.y; by < cell_max.y; ++by) {
+                for (size_t bx = cell_min.x; bx < cell_max.x; ++bx) {
                     const glm::uvec3 brick = glm::uvec3(bx, by, bz);
                     float range_min = FLT_MAX, range_max = -FLT_MAX;
                     for (uint32_t z = 0; z < 2; ++z) {
                         for (uint32_t y = 0; y < 2; ++y) {
                             for (uint32_t x = 0; x < 2; ++x) {
+                                // cells at the upper border of odd-sized levels have fewer children
                                 const glm::uvec3 source_at = 2u * brick + glm::uvec3(x, y, z);
+                                if (glm::any(glm::greaterThanEqual(source_at, source.size()))) continue;
                                 const glm::vec2 curr = decode_range(source[source_at]);
                                 range_min = std::min(range_min, curr.x);
                                 range_max = std::max(range_max, curr.y);
@@ -141,44 +633,219 @@ BrickGrid::BrickGrid(const Grid& grid) :
     }
 }
 
-BrickGrid::BrickGrid(const std::shared_ptr<Grid>& grid) : BrickGrid(*grid) {}
+// ----------------------------------------------
+// incremental updates
 
-BrickGrid::~BrickGrid() {}
+template <uint32_t LOG2_BRICK_SIZE>
+void BrickGridT<LOG2_BRICK_SIZE>::update_region(const Grid& src, const glm::uvec3& min, const glm::uvec3& max) {
+    const glm::uvec3 lo = glm::min(min, index_extent()), hi = glm::min(max, index_extent());
+    if (glm::any(glm::lessThanEqual(hi, lo))) return;
+    // bricks whose dilated region [brick * BRICK_SIZE - dilation, brick * BRICK_SIZE + BRICK_SIZE + dilation) intersects the box
+    const glm::uvec3 brick_min = (lo - glm::min(lo, glm::uvec3(dilation))) / BRICK_SIZE;
+    const glm::uvec3 brick_max = glm::min((hi + dilation - 1u) / BRICK_SIZE + 1u, n_bricks);
+    const glm::uvec3 n_update = brick_max - brick_min;
 
-float BrickGrid::lookup(const glm::uvec3& ipos) const {
-    const glm::uvec3 brick = ipos >> 3u;
-    const glm::uvec3 ptr = decode_ptr(indirection[brick]);
-    const glm::vec2 minmax = decode_range(range[brick]);
-    const glm::uvec3 voxel = (ptr << 3u) + glm::uvec3(ipos & 7u);
-    return decode_voxel(atlas[voxel], minmax);
-}
+    // re-encode affected bricks in parallel from their dilated regions (clipped at the lower grid border)
+    struct Update {
+        uint32_t range;
+        uint32_t log2_bits;
+        std::array<uint8_t, MAX_STORED_VOXELS> encoded;
+    };
+    std::vector<Update> updates(size_t(n_update.x) * n_update.y * n_update.z);
+    std::vector<int> slices(n_update.z);
+    std::iota(slices.begin(), slices.end(), 0);
+    std::for_each(std::execution::par_unseq, slices.begin(), slices.end(), [&](int uz) {
+        const size_t region_edge = BRICK_SIZE + 2 * dilation;
+        std::vector<float> region(region_edge * region_edge * region_edge);
+        std::array<float, MAX_STORED_VOXELS> values;
+        for (uint32_t uy = 0; uy < n_update.y; ++uy) {
+            for (uint32_t ux = 0; ux < n_update.x; ++ux) {
+                const glm::uvec3 brick = brick_min + glm::uvec3(ux, uy, uz);
+                Update& update = updates[(size_t(uz) * n_update.y + uy) * n_update.x + ux];
+                const glm::uvec3 region_min = brick * BRICK_SIZE - glm::min(brick * BRICK_SIZE, glm::uvec3(dilation));
+                const glm::uvec3 region_max = brick * BRICK_SIZE + BRICK_SIZE + dilation;
+                const glm::uvec3 region_size = region_max - region_min;
+                src.copy_region(region_min, region_max, region.data());
+                float local_min = FLT_MAX, local_max = -FLT_MAX;
+                reduce_min_max(region.data(), size_t(region_size.x) * region_size.y * region_size.z, local_min, local_max);
+                update.range = encode_sparse_range(local_min, local_max, sparsity_threshold);
+                const glm::vec2 local_range = decode_range(update.range);
+                if (local_range.x == local_range.y) continue;
+                gather_brick<BRICK_SIZE>(region.data(), glm::ivec3(region_min), region_size.x, region_size.y, brick, apron, index_extent(), values.data());
+                update.log2_bits = encode_brick(values.data(), local_range, update.encoded.data());
+            }
+        }
+    });
 
-std::pair<float, float> BrickGrid::minorant_majorant() const { return min_maj; }
+    // count references of shared slots once, if the atlas holds fewer slots in use than non-empty bricks
+    size_t n_free = 0;
+    for (const auto& list : free_slots) n_free += list.size();
+    if (!slot_refs_built && active_counter != brick_counter - n_free) {
+        for (size_t i = 0; i < range.data.size(); ++i) {
+            const glm::vec2 minmax = decode_range(range.data[i]);
+            if (minmax.x != minmax.y) slot_refs[indirection.data[i]]++;
+        }
+        for (auto it = slot_refs.begin(); it != slot_refs.end();)
+            it = it->second > 1 ? std::next(it) : slot_refs.erase(it);
+        slot_refs_built = true;
+    }
 
-glm::uvec3 BrickGrid::index_extent() const { return n_bricks * BRICK_SIZE; }
+    // release, rewrite or allocate atlas slots
+    for (uint32_t uz = 0; uz < n_update.z; ++uz) {
+        for (uint32_t uy = 0; uy < n_update.y; ++uy) {
+            for (uint32_t ux = 0; ux < n_update.x; ++ux) {
+                const glm::uvec3 brick = brick_min + glm::uvec3(ux, uy, uz);
+                const Update& update = updates[(size_t(uz) * n_update.y + uy) * n_update.x + ux];
+                const glm::vec2 old_range = decode_range(range[brick]), new_range = decode_range(update.range);
+                const bool had_slot = old_range.x != old_range.y, needs_slot = new_range.x != new_range.y;
+                const uint32_t old_ptr = indirection[brick];
+                const uint32_t old_log2_bits = pointer_mode == VARIABLE ? old_ptr & 3u : 3u;
+                range[brick] = update.range;
+                // release old slot unless it is shared or can be rewritten in place
+                bool exclusive = had_slot;
+                if (had_slot) {
+                    const auto shared = slot_refs.find(old_ptr);
+                    if (shared != slot_refs.end()) {
+                        exclusive = false;
+                        if (--shared->second == 1) slot_refs.erase(shared);
+                    }
+                    active_counter--;
+                }
+                if (exclusive && needs_slot && old_log2_bits == update.log2_bits) {
+                    store_brick(old_ptr, update.encoded.data());
+                    active_counter++;
+                    continue;
+                }
+                if (exclusive) free_slots[old_log2_bits].push_back(old_ptr);
+                indirection[brick] = 0;
+                if (!needs_slot) continue;
+                // allocate from released slots of the same size, or append to the atlas
+                uint32_t ptr;
+                std::vector<uint32_t>& free_list = free_slots[update.log2_bits];
+                if (!free_list.empty()) {
+                    ptr = free_list.back();
+                    free_list.pop_back();
+                } else if (pointer_mode == VARIABLE) {
+                    const size_t units = size_t(1) << update.log2_bits;
+                    if (unit_counter + units > (size_t(1) << 30))
+                        throw std::runtime_error("exceeded atlas capacity for variable bit depth");
+                    ptr = uint32_t(unit_counter << 2) | update.log2_bits;
+                    unit_counter += units;
+                    brick_counter++;
+                    const size_t slice_units = 8 * size_t(n_bricks.x);
+                    if (unit_counter > atlas.size().z * slice_units)
+                        atlas.resize(glm::uvec3(atlas.size().x, atlas.size().y, (unit_counter + slice_units - 1) / slice_units), 0);
+                } else {
+                    const size_t id = brick_counter;
+                    if (id >= (pointer_mode == PACKED ? size_t(n_bricks.x) * n_bricks.y * MAX_BRICKS : size_t(UINT32_MAX)))
+                        throw std::runtime_error("exceeded atlas capacity");
+                    ptr = pointer_mode == PACKED ? encode_ptr(indirection.to_coord(id)) : uint32_t(id);
+                    brick_counter++;
+                    // grow atlas by brick slices (z is the outermost dimension, contents stay in place)
+                    const size_t slice_bricks = pointer_mode == PACKED ? size_t(n_bricks.x) * n_bricks.y : n_bricks.x;
+                    const size_t slices_needed = (brick_counter + slice_bricks - 1) / slice_bricks * (pointer_mode == PACKED ? stored_size() : 1);
+                    if (slices_needed > atlas.size().z)
+                        atlas.resize(glm::uvec3(atlas.size().x, atlas.size().y, slices_needed), 0);
+                }
+                indirection[brick] = ptr;
+                store_brick(ptr, update.encoded.data());
+                active_counter++;
+            }
+        }
+    }
 
-size_t BrickGrid::num_voxels() const { return brick_counter * VOXELS_PER_BRICK; }
+    update_mipmaps(brick_min, brick_max);
+    // global bounds from the root cell, so they shrink as well when the region lowered the extremes (at range precision)
+    const glm::vec2 root = decode_range(range_mipmaps.empty() ? range.data[0] : range_mipmaps.back().data[0]);
+    min_maj = { root.x, root.y };
+}
 
-size_t BrickGrid::size_bytes() const {
-    const size_t dense_bricks = n_bricks.x * n_bricks.y * n_bricks.z;
-    const size_t size_indirection = sizeof(uint32_t) * dense_bricks;
-    const size_t size_range = sizeof(uint32_t) * dense_bricks;
-    const size_t size_atlas = sizeof(uint8_t) * brick_counter * VOXELS_PER_BRICK;
-    size_t size_mipmaps = 0;
-    for (const auto& mip : range_mipmaps)
-        size_mipmaps += sizeof(uint32_t) * mip.stride.x * mip.stride.y * mip.stride.z;
-    return size_indirection + size_range + size_atlas + size_mipmaps;
+// ----------------------------------------------
+// ray traversal
+
+template <uint32_t LOG2_BRICK_SIZE>
+BrickGridT<LOG2_BRICK_SIZE>::RayIterator::RayIterator(const BrickGridT& grid, const glm::vec3& ipos, const glm::vec3& idir, float t_min, float t_max, float threshold) :
+    grid(grid), origin(ipos), dir(idir), t(t_min), t_far(t_max), eps(0), threshold(threshold)
+{
+    // clip ray against the grid bounds
+    const glm::vec3 extent = glm::vec3(grid.index_extent());
+    for (int a = 0; a < 3; ++a) {
+        if (dir[a] == 0.f) {
+            if (origin[a] < 0.f || origin[a] >= extent[a]) t_far = -FLT_MAX;
+            continue;
+        }
+        const float t0 = (0.f - origin[a]) / dir[a], t1 = (extent[a] - origin[a]) / dir[a];
+        t = std::max(t, std::min(t0, t1));
+        t_far = std::min(t_far, std::max(t0, t1));
+    }
+    // small step along the ray to resolve cell boundaries robustly
+    const float len = glm::length(dir);
+    eps = len > 0.f ? 1e-3f / len : FLT_MAX;
 }
 
-std::string BrickGrid::to_string(const std::string& indent) const {
+template <uint32_t LOG2_BRICK_SIZE>
+bool BrickGridT<LOG2_BRICK_SIZE>::RayIterator::next(RaySegment& segment) {
+    const uint32_t n_levels = grid.range_mipmaps.size();
+    while (t < t_far) {
+        // sample slightly past t to select the cell the ray is entering
+        const glm::vec3 p = origin + dir * (t + eps);
+        // descend from the coarsest mip level until hitting an empty cell or a non-empty brick
+        for (int level = n_levels; level >= 0; --level) {
+            const Buf3D<uint32_t>& source = level == 0 ? grid.range : grid.range_mipmaps[level - 1];
+            const float cell_size = float(BRICK_SIZE << level);
+            const glm::uvec3 cell = glm::uvec3(glm::clamp(glm::ivec3(glm::floor(p / cell_size)), glm::ivec3(0), glm::ivec3(source.size()) - 1));
+            const glm::vec2 minmax = decode_range(source[cell]);
+            const bool empty = minmax.y <= threshold;
+            if (!empty && level > 0) continue;
+            // compute exit distance of the cell
+            float t_exit = t_far;
+            for (int a = 0; a < 3; ++a) {
+                if (dir[a] == 0.f) continue;
+                const float plane = (cell[a] + (dir[a] > 0.f ? 1u : 0u)) * cell_size;
+                t_exit = std::min(t_exit, (plane - origin[a]) / dir[a]);
+            }
+            // always make progress, even in case of numerical trouble at cell boundaries
+            const float t_entry = t;
+            t = std::max(t_exit, std::nextafter(t + eps, FLT_MAX));
+            if (!empty) {
+                segment = RaySegment{ t_entry, std::min(t, t_far), minmax.x, minmax.y };
+                return true;
+            }
+            break;
+        }
+    }
+    return false;
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::string BrickGridT<LOG2_BRICK_SIZE>::to_string(const std::string& indent) const {
     std::stringstream out;
     out << Grid::to_string(indent) << std::endl;
     out << indent << "voxel dim: " << glm::to_string(index_extent()) << std::endl;
     out << indent << "brick dim: " << glm::to_string(n_bricks) << std::endl;
-    const size_t bricks_allocd = brick_counter, bricks_capacity = atlas.size().x * atlas.size().y * atlas.size().z / VOXELS_PER_BRICK;
-    out << indent << "bricks in atlas: " << bricks_allocd << " / " << bricks_capacity << " (" << uint32_t(std::round(100 * bricks_allocd / float(bricks_capacity))) << "%)" << std::endl;
+    out << indent << "mipmap levels: " << range_mipmaps.size() << std::endl;
+    if (apron) out << indent << "apron: " << apron << " voxel (" << stored_size() << "^3 stored per brick)" << std::endl;
+    out << indent << "range dilation: " << dilation << " voxels" << std::endl;
+    if (sparsity_threshold > -FLT_MAX) out << indent << "sparsity threshold: " << sparsity_threshold << std::endl;
+    out << indent << "pointer mode: " << (pointer_mode == PACKED ? "packed" : pointer_mode == WIDE ? "wide" : "variable") << std::endl;
+    const size_t bricks_allocd = brick_counter, bricks_capacity = atlas.data.size() / encoded_bytes(3);
+    if (pointer_mode == VARIABLE)
+        out << indent << "bricks in atlas: " << bricks_allocd << " (bit-packed in " << atlas.data.size() << " bytes)" << std::endl;
+    else if (bricks_capacity > 0)
+        out << indent << "bricks in atlas: " << bricks_allocd << " / " << bricks_capacity << " (" << uint32_t(std::round(100 * bricks_allocd / float(bricks_capacity))) << "%)" << std::endl;
+    else
+        out << indent << "bricks in atlas: " << bricks_allocd << " (no atlas allocated)" << std::endl;
+    if (active_counter > brick_counter)
+        out << indent << "deduplicated bricks: " << active_counter - brick_counter << " / " << active_counter << std::endl;
     out << indent << "atlas dim: " << glm::to_string(atlas.size()) << std::endl;
     return out.str();
 }
 
+// ----------------------------------------------
+// explicit instantiations
+
+template class BrickGridT<2>;
+template class BrickGridT<3>;
+template class BrickGridT<4>;
+
 }
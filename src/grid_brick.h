@@ -3,34 +3,140 @@
 #include "grid.h"
 #include "buf3d.h"
 
+#include <cfloat>
+#include <array>
 #include <vector>
+#include <unordered_map>
 #include <memory>
 #include <atomic>
 
 namespace voldata {
 
-class BrickGrid : public Grid {
+// sparse brick grid with brick size (1 << LOG2_BRICK_SIZE)^3 and a min/max range mipmap hierarchy down to a single cell
+// the brick size is a compile-time constant so that address computations in lookups fold to shifts and masks
+template <uint32_t LOG2_BRICK_SIZE = 3>
+class BrickGridT : public Grid {
 public:
-    BrickGrid();
-    BrickGrid(const Grid& grid);
-    BrickGrid(const std::shared_ptr<Grid>& grid);
-    virtual ~BrickGrid();
+    static constexpr uint32_t BRICK_SIZE = 1u << LOG2_BRICK_SIZE;
+    static constexpr uint32_t VOXELS_PER_BRICK = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+    static constexpr uint32_t MAX_STORED_VOXELS = (BRICK_SIZE + 2) * (BRICK_SIZE + 2) * (BRICK_SIZE + 2);    // voxels per stored brick, including an apron
+
+    // encoding of brick pointers in the indirection buffer:
+    // PACKED: 3x 10bit atlas brick coordinates, limited to 1024 bricks per axis, suitable for 3D textures
+    // WIDE: 32bit linear brick index into a brick-major atlas, no per-axis limit
+    // VARIABLE: 30bit offset in units of VOXELS_PER_BRICK / 8 bytes and 2bit log2 of the brick's bit depth (1, 2, 4 or 8 bits per voxel)
+    // AUTO: VARIABLE if a tolerance is given and the grid fits, else PACKED if the grid fits, WIDE otherwise
+    enum PointerMode { AUTO, PACKED, WIDE, VARIABLE };
+
+    // construction options
+    struct Options {
+        PointerMode pointer_mode = AUTO;
+        bool deduplicate = false;       // let bricks with bit-identical encoded data share one atlas slot (hashed during construction)
+        float tolerance = 0.f;          // max. absolute error to reduce the bit depth of a brick (VARIABLE), never below the 8 bit quantization error
+        bool apron = false;             // store bricks with a 1 voxel border of neighboring values (PACKED or WIDE), trilinear samples then decode a single brick
+        uint32_t dilation = 2;          // voxels by which brick ranges are dilated into the neighborhood (conservative bounds for filtered lookups), at least the apron
+        float sparsity_threshold = -FLT_MAX;    // bricks with a (dilated) majorant below are stored empty, as constant minorant, to cull faint noise
+    };
+
+    BrickGridT();
+    BrickGridT(const Grid& grid);
+    BrickGridT(const Grid& grid, const Options& options);
+    BrickGridT(const std::shared_ptr<Grid>& grid);
+    BrickGridT(const std::shared_ptr<Grid>& grid, const Options& options);
+    virtual ~BrickGridT();
 
     float lookup(const glm::uvec3& ipos) const;
+    void lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const;
+    void copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const;
+    using Grid::copy_region;
+    void for_each_active_block(const BlockCallback& callback) const;
+    float sample_trilinear(const glm::vec3& ipos) const;
+    void sample_trilinear_batch(const glm::vec3* ipos, float* values, size_t n) const;
     std::pair<float, float> minorant_majorant() const;
+    std::pair<float, float> range_query(const glm::uvec3& min, const glm::uvec3& max) const;   // bounds within index-space box [min, max)
+    std::pair<float, float> range_query(const glm::vec3& min, const glm::vec3& max) const;     // conservative bounds within continuous box
     glm::uvec3 index_extent() const;
     size_t num_voxels() const;
     size_t size_bytes() const;
     virtual std::string to_string(const std::string& indent="") const override;
 
+    // re-encode the bricks affected by changes of src within index-space box [min, max), src must share the index space
+    // atlas slots are rewritten, allocated or released as bricks change, not safe to call concurrently with lookups
+    // minorant_majorant() is then recomputed from the root range cell, i.e. at float16 range precision
+    void update_region(const Grid& src, const glm::uvec3& min, const glm::uvec3& max);
+
+    template <bool PACKED_LAYOUT> float lookup_voxel(const glm::uvec3& ipos) const;      // lookup, PACKED_LAYOUT: PACKED atlas without apron, addressed by shifts and masks only
+    template <bool PACKED_LAYOUT> void lookup_voxels(const glm::uvec3* ipos, float* values, size_t n) const;   // batched lookup as above
+    void select_lookup();                                   // select the lookup path for pointer mode and apron, once constructed or loaded
+    size_t brick_offset(uint32_t ptr) const;                // index of the first voxel of the brick in atlas.data, given its indirection entry
+    size_t voxel_offset(const glm::uvec3& voxel) const;     // offset of a voxel within the brick relative to brick_offset(), in voxels
+    size_t stored_offset(const glm::uvec3& stored) const;   // as above, for a voxel of the stored brick including the apron, i.e. voxel + apron
+    size_t encoded_bytes(uint32_t log2_bits) const;         // bytes of an encoded brick: bit-packed (VARIABLE) or stored_size()^3
+    inline uint32_t stored_size() const { return BRICK_SIZE + 2 * apron; }  // edge length of stored bricks
+    float fetch_voxel(uint32_t ptr, size_t offset, const glm::vec2& range, const glm::uvec3& voxel) const;    // decode a voxel of the brick at offset = brick_offset(ptr)
+    glm::uvec3 apron_corner(const glm::vec3& ipos, glm::uvec3& brick, glm::vec3& f) const;     // brick and stored voxel (+ apron) of the lower neighborhood corner of a trilinear sample, and its weights
+    static float decode_trilinear(const uint8_t* data, size_t dy, size_t dz, const glm::vec2& range, const glm::vec3& f);  // decode and blend the 8 bit 2^3 neighborhood at data, strides dy and dz
+    uint32_t encode_brick(const float* values, const glm::vec2& range, uint8_t* encoded) const;    // quantize (and bit-pack) brick values, returns log2 of the bit depth
+    void store_brick(uint32_t ptr, const uint8_t* encoded);                                         // write encoded brick data to its atlas slot
+    void build_mipmaps();                                                                           // allocate and compute all range mipmap levels
+    void update_mipmaps(const glm::uvec3& brick_min, const glm::uvec3& brick_max);                 // recompute range mipmap cells covering bricks [brick_min, brick_max)
+
+    // ray segment through a non-empty cell of the brick hierarchy
+    struct RaySegment {
+        float t_min, t_max;         // ray parameter interval [t_min, t_max)
+        float minorant, majorant;   // local value bounds within the segment
+    };
+
+    // HDDA-style ray traversal in index space, descending the range mipmaps to skip empty space
+    // cells with majorant <= threshold are skipped, all others are yielded per brick in ray order
+    class RayIterator {
+    public:
+        RayIterator(const BrickGridT& grid, const glm::vec3& ipos, const glm::vec3& idir, float t_min = 0.f, float t_max = FLT_MAX, float threshold = 0.f);
+
+        bool next(RaySegment& segment);     // advance to the next non-empty segment, returns false when done
+
+        // data
+        const BrickGridT& grid;
+        glm::vec3 origin, dir;
+        float t, t_far, eps;
+        float threshold;
+    };
+
+    RayIterator traverse(const glm::vec3& ipos, const glm::vec3& idir, float t_min = 0.f, float t_max = FLT_MAX, float threshold = 0.f) const;
+
     // data
     glm::uvec3 n_bricks;
+    PointerMode pointer_mode;                       // PACKED, WIDE or VARIABLE, resolved on construction
     std::pair<float, float> min_maj;
-    std::atomic<size_t> brick_counter;
-    Buf3D<uint32_t> indirection;                    // 3x 10bits uint: (ptr_x, ptr_y, ptr_z, 2bit unused)
+    std::atomic<size_t> brick_counter;              // number of bricks stored in the atlas
+    std::atomic<size_t> active_counter;             // number of non-empty bricks, exceeds brick_counter if deduplicated
+    std::atomic<size_t> unit_counter;               // number of VOXELS_PER_BRICK / 8 byte units allocated in the atlas (VARIABLE)
+    float tolerance;                                // error tolerance for the bit depth of bricks (VARIABLE)
+    uint32_t apron;                                 // border voxels per side of stored bricks, 0 or 1 (clamped at the grid border)
+    uint32_t dilation;                              // voxels per side by which brick ranges are dilated
+    float sparsity_threshold;                       // bricks with a majorant below are stored empty
+    Buf3D<uint32_t> indirection;                    // PACKED: 3x 10bits uint (ptr_x, ptr_y, ptr_z, 2bit unused), WIDE: brick index, VARIABLE: offset and bit depth
     Buf3D<uint32_t> range;                          // 2x float16: (minorant, majorant)
-    Buf3D<uint8_t> atlas;                           // 512x uint8_t: 8x8x8 normalized brick data
-    std::vector<Buf3D<uint32_t>> range_mipmaps;     // 3x float16 min/max mipmas of range data
+    Buf3D<uint8_t> atlas;                           // stored_size()^3 x uint8_t: normalized brick data, PACKED: bricks tiled in 3D, WIDE: (stored_size()^3, n_bricks.x, n_bricks.y * n_bricks.z), VARIABLE: bit-packed bricks
+    std::vector<Buf3D<uint32_t>> range_mipmaps;     // float16 min/max mipmaps of range data, level i + 1 has ceil(size / 2) cells of level i, the last one a single cell
+    std::array<std::vector<uint32_t>, 4> free_slots;    // atlas slots released by update_region(), per log2 bit depth
+    std::unordered_map<uint32_t, uint32_t> slot_refs;   // reference counts of shared atlas slots (deduplicated), built on demand by update_region()
+    bool slot_refs_built;
+    float (BrickGridT::*lookup_fn)(const glm::uvec3& ipos) const;                           // lookup path set by select_lookup()
+    void (BrickGridT::*lookup_batch_fn)(const glm::uvec3* ipos, float* values, size_t n) const;
 };
 
+// instantiated in grid_brick.cpp
+extern template class BrickGridT<2>;
+extern template class BrickGridT<3>;
+extern template class BrickGridT<4>;
+
+using BrickGrid = BrickGridT<3>;       // 8^3 bricks (default)
+using BrickGrid4 = BrickGridT<2>;      // 4^3 bricks: finer empty space culling
+using BrickGrid16 = BrickGridT<4>;     // 16^3 bricks: smaller indirection, larger domains
+
+// 2x float16 (minorant, majorant) encoding of range and mipmap entries
+uint32_t encode_range(float x, float y);
+glm::vec2 decode_range(uint32_t data);
+
 }
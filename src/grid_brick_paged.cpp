@@ -0,0 +1,295 @@
+#include "grid_brick_paged.h"
+#include "serialization.h"
+
+#include <sstream>
+#include <numeric>
+#include <algorithm>
+#include <glm/gtx/string_cast.hpp>
+
+namespace voldata {
+
+template <uint32_t LOG2_BRICK_SIZE>
+PagedBrickGridT<LOG2_BRICK_SIZE>::PagedBrickGridT(const fs::path& path, size_t cache_bytes) :
+    Grid(),
+    path(path),
+    atlas_offset(0),
+    slot_bytes(0),
+    cache_slots(0)
+{
+    atlas_offset = load_brick_grid_header(path, index);
+    transform = index.transform;
+    // no need for more slots than bricks in the atlas
+    slot_bytes = index.encoded_bytes(3);
+    cache_slots = std::clamp<size_t>(std::min<size_t>(cache_bytes / slot_bytes, index.brick_counter), 1, UINT32_MAX);
+    // distribute the slots evenly over the shards
+    const size_t n_shards = std::min(cache_slots, MAX_SHARDS);
+    for (size_t i = 0; i < n_shards; ++i) {
+        auto shard = std::make_unique<Shard>();
+        shard->file.rdbuf()->pubsetbuf(nullptr, 0);
+        shard->file.open(path, std::ios::binary);
+        if (!shard->file) throw std::runtime_error("Unable to open " + path.string());
+        shard->slots = cache_slots / n_shards + (i < cache_slots % n_shards ? 1 : 0);
+        shard->cache.resize(shard->slots * slot_bytes);
+        shard->unused_slots.resize(shard->slots);
+        std::iota(shard->unused_slots.begin(), shard->unused_slots.end(), 0);
+        shards.push_back(std::move(shard));
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+PagedBrickGridT<LOG2_BRICK_SIZE>::~PagedBrickGridT() {}
+
+template <uint32_t LOG2_BRICK_SIZE>
+float PagedBrickGridT<LOG2_BRICK_SIZE>::lookup(const glm::uvec3& ipos) const {
+    const glm::uvec3 brick = ipos >> LOG2_BRICK_SIZE;
+    const glm::vec2 minmax = decode_range(index.range[brick]);
+    if (minmax.x == minmax.y) return minmax.x;     // empty brick, nothing to page in
+    const uint32_t ptr = index.indirection[brick];
+    Shard& cache = shard(ptr);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return decode_stored_voxel(fetch_brick(cache, ptr), ptr, minmax, (ipos & (BRICK_SIZE - 1u)) + index.apron);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void PagedBrickGridT<LOG2_BRICK_SIZE>::lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const {
+    // process queries grouped by brick, copy each brick out of the cache once so the lock is not held while decoding
+    const std::vector<size_t> order = block_order(ipos, n, LOG2_BRICK_SIZE);
+    std::array<uint8_t, Index::MAX_STORED_VOXELS> brick_data;
+    size_t last = SIZE_MAX;
+    uint32_t ptr = 0;
+    glm::vec2 minmax;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t j = order.empty() ? i : order[i];
+        const size_t brick = index.indirection.to_idx(ipos[j] >> LOG2_BRICK_SIZE);
+        if (brick != last) {
+            ptr = index.indirection.data[brick];
+            minmax = decode_range(index.range.data[brick]);
+            if (minmax.x != minmax.y) {
+                Shard& cache = shard(ptr);
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                std::copy_n(fetch_brick(cache, ptr), slot_bytes, brick_data.data());
+            }
+            last = brick;
+        }
+        values[j] = minmax.x == minmax.y ? minmax.x : decode_stored_voxel(brick_data.data(), ptr, minmax, (ipos[j] & (BRICK_SIZE - 1u)) + index.apron);
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void PagedBrickGridT<LOG2_BRICK_SIZE>::copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // decode brick-by-brick, voxels outside of the grid are zero
+    const glm::uvec3 size = max - min;
+    const glm::uvec3 brick_min = min / BRICK_SIZE, brick_max = (max - 1u) / BRICK_SIZE;
+    std::array<uint8_t, Index::MAX_STORED_VOXELS> brick_data;
+    for (uint32_t bz = brick_min.z; bz <= brick_max.z; ++bz) {
+        for (uint32_t by = brick_min.y; by <= brick_max.y; ++by) {
+            for (uint32_t bx = brick_min.x; bx <= brick_max.x; ++bx) {
+                const glm::uvec3 brick = glm::uvec3(bx, by, bz);
+                const glm::uvec3 lo = glm::max(brick * BRICK_SIZE, min), hi = glm::min(brick * BRICK_SIZE + BRICK_SIZE, max);
+                const bool inside = glm::all(glm::lessThan(brick, index.n_bricks));
+                const uint32_t ptr = inside ? index.indirection[brick] : 0;
+                const glm::vec2 minmax = inside ? decode_range(index.range[brick]) : glm::vec2(0);
+                const bool empty = minmax.x == minmax.y;
+                if (!empty) {
+                    Shard& cache = shard(ptr);
+                    std::lock_guard<std::mutex> lock(cache.mutex);
+                    std::copy_n(fetch_brick(cache, ptr), slot_bytes, brick_data.data());
+                }
+                for (uint32_t z = lo.z; z < hi.z; ++z) {
+                    for (uint32_t y = lo.y; y < hi.y; ++y) {
+                        float* row = dst + (size_t(z - min.z) * size.y + y - min.y) * size.x;
+                        if (empty) {
+                            std::fill(row + lo.x - min.x, row + hi.x - min.x, minmax.x);
+                            continue;
+                        }
+                        for (uint32_t x = lo.x; x < hi.x; ++x)
+                            row[x - min.x] = decode_stored_voxel(brick_data.data(), ptr, minmax, glm::uvec3(x, y, z) % BRICK_SIZE + index.apron);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+float PagedBrickGridT<LOG2_BRICK_SIZE>::sample_trilinear(const glm::vec3& ipos) const {
+    if (index.apron == 0) return Grid::sample_trilinear(ipos);
+    // as BrickGridT::sample_trilinear(), decoding the neighborhood from one cached brick (8 bits per voxel, x fastest)
+    glm::uvec3 brick;
+    glm::vec3 f;
+    const glm::uvec3 stored = index.apron_corner(ipos, brick, f);
+    const glm::vec2 minmax = decode_range(index.range[brick]);
+    if (minmax.x == minmax.y) return minmax.x;
+    const uint32_t ptr = index.indirection[brick];
+    const size_t dy = index.stored_size(), dz = dy * dy;
+    Shard& cache = shard(ptr);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return Index::decode_trilinear(fetch_brick(cache, ptr) + stored.z * dz + stored.y * dy + stored.x, dy, dz, minmax, f);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void PagedBrickGridT<LOG2_BRICK_SIZE>::sample_trilinear_batch(const glm::vec3* ipos, float* values, size_t n) const {
+    if (index.apron == 0) return Grid::sample_trilinear_batch(ipos, values, n);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = sample_trilinear(ipos[i]);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void PagedBrickGridT<LOG2_BRICK_SIZE>::for_each_active_block(const BlockCallback& callback) const { index.for_each_active_block(callback); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::pair<float, float> PagedBrickGridT<LOG2_BRICK_SIZE>::minorant_majorant() const { return index.minorant_majorant(); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::pair<float, float> PagedBrickGridT<LOG2_BRICK_SIZE>::range_query(const glm::uvec3& min, const glm::uvec3& max) const { return index.range_query(min, max); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::pair<float, float> PagedBrickGridT<LOG2_BRICK_SIZE>::range_query(const glm::vec3& min, const glm::vec3& max) const { return index.range_query(min, max); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+glm::uvec3 PagedBrickGridT<LOG2_BRICK_SIZE>::index_extent() const { return index.index_extent(); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t PagedBrickGridT<LOG2_BRICK_SIZE>::num_voxels() const { return index.num_voxels(); }
+
+template <uint32_t LOG2_BRICK_SIZE>
+typename PagedBrickGridT<LOG2_BRICK_SIZE>::Index::RayIterator PagedBrickGridT<LOG2_BRICK_SIZE>::traverse(const glm::vec3& ipos, const glm::vec3& idir, float t_min, float t_max, float threshold) const {
+    return index.traverse(ipos, idir, t_min, t_max, threshold);
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+size_t PagedBrickGridT<LOG2_BRICK_SIZE>::size_bytes() const {
+    const size_t dense_bricks = size_t(index.n_bricks.x) * index.n_bricks.y * index.n_bricks.z;
+    size_t size_mipmaps = 0;
+    for (const auto& mip : index.range_mipmaps)
+        size_mipmaps += sizeof(uint32_t) * mip.data.size();
+    return 2 * sizeof(uint32_t) * dense_bricks + size_mipmaps + cache_slots * slot_bytes;
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+std::string PagedBrickGridT<LOG2_BRICK_SIZE>::to_string(const std::string& indent) const {
+    std::stringstream out;
+    out << Grid::to_string(indent) << std::endl;
+    out << indent << "voxel dim: " << glm::to_string(index_extent()) << std::endl;
+    out << indent << "brick dim: " << glm::to_string(index.n_bricks) << std::endl;
+    out << indent << "mipmap levels: " << index.range_mipmaps.size() << std::endl;
+    if (index.apron) out << indent << "apron: " << index.apron << " voxel (" << index.stored_size() << "^3 stored per brick)" << std::endl;
+    out << indent << "pointer mode: " << (index.pointer_mode == Index::PACKED ? "packed" : index.pointer_mode == Index::WIDE ? "wide" : "variable") << std::endl;
+    out << indent << "bricks in file: " << index.brick_counter << " (" << index.active_counter << " active)" << std::endl;
+    out << indent << "paged from: " << path.string() << std::endl;
+    size_t n_cached = 0, hits = 0, misses = 0;
+    for (const auto& cache : shards) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        n_cached += cache->lru.size();
+        hits += cache->hits;
+        misses += cache->misses;
+    }
+    out << indent << "brick cache: " << n_cached << " / " << cache_slots << " bricks (" << cache_slots * slot_bytes / (1 << 20) << " MiB in " << shards.size() << " shards), " << hits << " hits, " << misses << " misses" << std::endl;
+    return out.str();
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void PagedBrickGridT<LOG2_BRICK_SIZE>::update_region(const Grid&, const glm::uvec3&, const glm::uvec3&) {
+    throw std::runtime_error("update_region() is not supported for paged brick grids");
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void PagedBrickGridT<LOG2_BRICK_SIZE>::prefetch(const glm::uvec3& min, const glm::uvec3& max) const {
+    const glm::uvec3 lo = glm::min(min, index.index_extent()), hi = glm::min(max, index.index_extent());
+    if (glm::any(glm::lessThanEqual(hi, lo))) return;
+    // page in bricks in memory order, skip shards that would evict bricks prefetched here
+    const glm::uvec3 brick_lo = lo / BRICK_SIZE, brick_hi = (hi - 1u) / BRICK_SIZE + 1u;
+    std::unordered_map<const Shard*, size_t> n_fetched;
+    for (uint32_t bz = brick_lo.z; bz < brick_hi.z; ++bz) {
+        for (uint32_t by = brick_lo.y; by < brick_hi.y; ++by) {
+            for (uint32_t bx = brick_lo.x; bx < brick_hi.x; ++bx) {
+                const glm::uvec3 brick = glm::uvec3(bx, by, bz);
+                const glm::vec2 minmax = decode_range(index.range[brick]);
+                if (minmax.x == minmax.y) continue;
+                const uint32_t ptr = index.indirection[brick];
+                Shard& cache = shard(ptr);
+                if (n_fetched[&cache] == cache.slots) continue;
+                n_fetched[&cache]++;
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                fetch_brick(cache, ptr);
+            }
+        }
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+void PagedBrickGridT<LOG2_BRICK_SIZE>::clear_cache() const {
+    for (const auto& cache : shards) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->lru.clear();
+        cache->cached.clear();
+        cache->unused_slots.resize(cache->slots);
+        std::iota(cache->unused_slots.begin(), cache->unused_slots.end(), 0);
+    }
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+typename PagedBrickGridT<LOG2_BRICK_SIZE>::Shard& PagedBrickGridT<LOG2_BRICK_SIZE>::shard(uint32_t ptr) const {
+    // multiplicative hash, neighboring bricks spread over the shards
+    return *shards[((ptr * 2654435761u) >> 16) % shards.size()];
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+const uint8_t* PagedBrickGridT<LOG2_BRICK_SIZE>::fetch_brick(Shard& shard, uint32_t ptr) const {
+    const auto it = shard.cached.find(ptr);
+    if (it != shard.cached.end()) {
+        shard.hits++;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return shard.cache.data() + size_t(it->second->second) * slot_bytes;
+    }
+    shard.misses++;
+    // evict the least recently used brick if the shard is full
+    if (shard.unused_slots.empty()) {
+        shard.unused_slots.push_back(shard.lru.back().second);
+        shard.cached.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+    }
+    // read the stored brick into brick-local layout (x fastest), the slot stays unused if reading fails
+    const uint32_t slot = shard.unused_slots.back();
+    uint8_t* dst = shard.cache.data() + size_t(slot) * slot_bytes;
+    auto read = [&](size_t offset, uint8_t* bytes, size_t n) {
+        shard.file.seekg(atlas_offset + offset);
+        shard.file.read(reinterpret_cast<char*>(bytes), n);
+        if (!shard.file) {
+            shard.file.clear();
+            throw std::runtime_error("Unable to read brick data from " + path.string());
+        }
+    };
+    const size_t offset = index.brick_offset(ptr);
+    if (index.pointer_mode == Index::PACKED) {
+        // bricks are tiled in 3D, read each stored row of the brick separately
+        const uint32_t size = index.stored_size();
+        for (uint32_t z = 0; z < size; ++z)
+            for (uint32_t y = 0; y < size; ++y)
+                read(offset + index.stored_offset(glm::uvec3(0, y, z)), dst + (z * size + y) * size, size);
+    } else
+        read(offset, dst, index.encoded_bytes(index.pointer_mode == Index::VARIABLE ? ptr & 3u : 3u));
+    shard.unused_slots.pop_back();
+    shard.lru.emplace_front(ptr, slot);
+    shard.cached[ptr] = shard.lru.begin();
+    return dst;
+}
+
+template <uint32_t LOG2_BRICK_SIZE>
+float PagedBrickGridT<LOG2_BRICK_SIZE>::decode_stored_voxel(const uint8_t* brick, uint32_t ptr, const glm::vec2& range, const glm::uvec3& stored) const {
+    // as fetch_voxel(), 8 bits per voxel unless bit-packed (little endian within bytes)
+    const uint32_t log2_bits = index.pointer_mode == Index::VARIABLE ? ptr & 3u : 3u, levels = (1u << (1u << log2_bits)) - 1u;
+    const size_t bit = ((size_t(stored.z) * index.stored_size() + stored.y) * index.stored_size() + stored.x) << log2_bits;
+    const uint32_t data = (brick[bit >> 3] >> (bit & 7u)) & levels;
+    return range.x + data * (1.f / levels) * (range.y - range.x);
+}
+
+// ----------------------------------------------
+// explicit instantiations
+
+template class PagedBrickGridT<2>;
+template class PagedBrickGridT<3>;
+template class PagedBrickGridT<4>;
+
+}
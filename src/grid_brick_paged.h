@@ -0,0 +1,85 @@
+#pragma once
+
+#include "grid_brick.h"
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace voldata {
+
+// out-of-core brick grid paged from a serialized brick grid file (see write_grid())
+// indirection, ranges and mipmaps stay resident in a brick grid without atlas, atlas bricks are read on demand into a fixed-size LRU brick cache
+// lookups fault bricks in transparently and are safe to call concurrently, the grid is read-only
+// the cache is split into shards by brick pointer, each with its own lock and file handle, so concurrent lookups rarely contend
+template <uint32_t LOG2_BRICK_SIZE = 3>
+class PagedBrickGridT : public Grid {
+public:
+    using Index = BrickGridT<LOG2_BRICK_SIZE>;
+    static constexpr uint32_t BRICK_SIZE = Index::BRICK_SIZE;
+    static constexpr uint32_t VOXELS_PER_BRICK = Index::VOXELS_PER_BRICK;
+
+    PagedBrickGridT(const fs::path& path, size_t cache_bytes = size_t(256) << 20);     // cache budget in bytes, one slot per (uncompressed) stored brick
+    virtual ~PagedBrickGridT();
+
+    float lookup(const glm::uvec3& ipos) const;
+    void lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const;
+    void copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const;
+    using Grid::copy_region;
+    void for_each_active_block(const BlockCallback& callback) const;
+    float sample_trilinear(const glm::vec3& ipos) const;
+    void sample_trilinear_batch(const glm::vec3* ipos, float* values, size_t n) const;
+    std::pair<float, float> minorant_majorant() const;
+    std::pair<float, float> range_query(const glm::uvec3& min, const glm::uvec3& max) const;   // bounds within index-space box [min, max)
+    std::pair<float, float> range_query(const glm::vec3& min, const glm::vec3& max) const;     // conservative bounds within continuous box
+    glm::uvec3 index_extent() const;
+    size_t num_voxels() const;
+    size_t size_bytes() const;                                  // resident bytes, including the full brick cache
+    virtual std::string to_string(const std::string& indent="") const override;
+
+    typename Index::RayIterator traverse(const glm::vec3& ipos, const glm::vec3& idir, float t_min = 0.f, float t_max = FLT_MAX, float threshold = 0.f) const;   // see BrickGridT::traverse()
+
+    void update_region(const Grid& src, const glm::uvec3& min, const glm::uvec3& max);     // not supported for paged grids, throws
+    void prefetch(const glm::uvec3& min, const glm::uvec3& max) const;                      // hint: page in non-empty bricks within index-space box [min, max), at most a full cache
+    void clear_cache() const;                                                                 // drop all cached bricks
+
+    // independently locked part of the brick cache
+    struct Shard {
+        std::mutex mutex;                                       // guards all of the below
+        std::ifstream file;                                     // unbuffered, bricks are read directly into cache slots
+        Buffer<uint8_t> cache;                                  // slots x slot_bytes
+        std::list<std::pair<uint32_t, uint32_t>> lru;           // (brick pointer, cache slot), most recently used first
+        std::unordered_map<uint32_t, typename std::list<std::pair<uint32_t, uint32_t>>::iterator> cached;    // brick pointer -> lru entry
+        std::vector<uint32_t> unused_slots;                     // cache slots not holding a brick
+        size_t slots = 0, hits = 0, misses = 0;
+    };
+
+    Shard& shard(uint32_t ptr) const;                           // shard caching the given brick
+    const uint8_t* fetch_brick(Shard& shard, uint32_t ptr) const;   // cached stored brick (x fastest or bit-packed), paged in on a miss, caller must hold shard.mutex
+    float decode_stored_voxel(const uint8_t* brick, uint32_t ptr, const glm::vec2& range, const glm::uvec3& stored) const;  // decode a voxel (+ apron) of cached brick data
+
+    // data
+    Index index;                                                // resident indirection, ranges and mipmaps, its atlas stays empty
+    fs::path path;
+    size_t atlas_offset;                                        // file offset of the serialized atlas data
+    size_t slot_bytes;                                          // bytes per cache slot, stored_size()^3
+    size_t cache_slots;                                         // capacity of the brick cache in bricks, over all shards
+    std::vector<std::unique_ptr<Shard>> shards;                 // at most MAX_SHARDS, with at least one slot each
+    static constexpr size_t MAX_SHARDS = 16;
+};
+
+// instantiated in grid_brick_paged.cpp
+extern template class PagedBrickGridT<2>;
+extern template class PagedBrickGridT<3>;
+extern template class PagedBrickGridT<4>;
+
+using PagedBrickGrid = PagedBrickGridT<3>;
+using PagedBrickGrid4 = PagedBrickGridT<2>;
+using PagedBrickGrid16 = PagedBrickGridT<4>;
+
+}
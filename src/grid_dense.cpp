@@ -1,105 +1,343 @@
 #include "grid_dense.h"
+#include "quantize.h"
 
+#include <cfloat>
+#include <cstring>
+#include <sstream>
 #include <numeric>
 #include <algorithm>
 #include <execution>
+#include <type_traits>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/string_cast.hpp>
 
 namespace voldata {
 
-DenseGrid::DenseGrid() : Grid(), n_voxels(0), min_value(0), max_value(0) {}
+// ----------------------------------------------
+// storage types and encoding helpers
 
-DenseGrid::DenseGrid(const Grid& grid) :
-    Grid(grid),
-    n_voxels(grid.index_extent()),
-    min_value(std::get<0>(grid.minorant_majorant())),
-    max_value(std::get<1>(grid.minorant_majorant()))
-{
-    std::vector<uint32_t> slices(n_voxels.z);
+struct half_t { uint16_t bits; };
+
+inline float decode_voxel(uint8_t data, float min, float max) { return min + (data / 255.f) * (max - min); }
+inline float decode_voxel(uint16_t data, float min, float max) { return min + (data / 65535.f) * (max - min); }
+inline float decode_voxel(half_t data, float, float) { return glm::detail::toFloat32(data.bits); }
+inline float decode_voxel(float data, float, float) { return data; }
+
+template <typename T> inline T encode_voxel(float value, float min, float max);
+template <> inline uint8_t encode_voxel<uint8_t>(float value, float min, float max) { return quantize_u8(value, min, max); }
+template <> inline uint16_t encode_voxel<uint16_t>(float value, float min, float max) {
+    if (!(max > min)) return 0;
+    return uint16_t(std::round(glm::clamp(65535 * (value - min) / (max - min), 0.f, 65535.f)));
+}
+template <> inline half_t encode_voxel<half_t>(float value, float, float) { return half_t{ glm::detail::toFloat16(value) }; }
+template <> inline float encode_voxel<float>(float value, float, float) { return value; }
+
+// invoke func with a value of the storage type matching the given format
+template <typename F> inline auto dispatch(DenseGrid::Format format, const F& func) {
+    switch (format) {
+        case DenseGrid::UINT16: return func(uint16_t());
+        case DenseGrid::FLOAT16: return func(half_t());
+        case DenseGrid::FLOAT32: return func(float());
+        default: return func(uint8_t());
+    }
+}
+
+template <typename T> inline const T* typed_data(const uint8_t* data) { return reinterpret_cast<const T*>(data); }
+template <typename T> inline T* typed_data(Buffer<uint8_t>& data) { return reinterpret_cast<T*>(data.data()); }
+
+// ----------------------------------------------
+// DenseGrid
+
+// store a linear (x-fastest) slice of encoded voxels w.r.t. the grid's layout
+template <typename T> static void store_slice(DenseGrid& grid, uint32_t z, const T* slice) {
+    T* data = typed_data<T>(grid.voxel_data);
+    for (uint32_t y = 0; y < grid.n_voxels.y; ++y) {
+        const T* src = slice + size_t(y) * grid.n_voxels.x;
+        for (uint32_t x = 0; x < grid.n_voxels.x;) {
+            const glm::uvec3 at = glm::uvec3(x, y, z);
+            const uint32_t n = std::min(grid.contiguous_voxels(at), grid.n_voxels.x - x);
+            std::memcpy(data + grid.voxel_index(at), src + x, n * sizeof(T));
+            x += n;
+        }
+    }
+}
+
+// encode voxel data slice-wise in parallel, encode_slice(z, T* slice) fills a linear slice of the grid
+template <typename T, typename F> static void encode_slices(DenseGrid& grid, const F& encode_slice) {
+    std::vector<uint32_t> slices(grid.n_voxels.z);
     std::iota(slices.begin(), slices.end(), 0);
-    // encode dense grid data with 8bit per voxel
-    voxel_data.resize(n_voxels.x * n_voxels.y * n_voxels.z);
+    const size_t slice_size = size_t(grid.n_voxels.x) * grid.n_voxels.y;
+    // voxel data is allocated uninitialized and overwritten slice-wise, only padding of partial tiles is cleared
+    if (grid.num_stored_voxels() > size_t(grid.n_voxels.x) * grid.n_voxels.y * grid.n_voxels.z)
+        grid.voxel_data.resize(grid.num_stored_voxels() * sizeof(T), 0);
+    else
+        grid.voxel_data.resize(grid.num_stored_voxels() * sizeof(T));
     std::for_each(std::execution::par_unseq, slices.begin(), slices.end(),
     [&](uint32_t z)
     {
-        for (uint32_t y = 0; y < n_voxels.y; ++y)
-            for (uint32_t x = 0; x < n_voxels.x; ++x) {
-                const float value = grid.lookup(glm::ivec3(x, y, z));
-                const size_t idx = z * n_voxels.x * n_voxels.y + y * n_voxels.x + x;
-                voxel_data[idx] = uint8_t(std::round(255 * (value - min_value) / (max_value - min_value)));
+        // encode linear slices in place, tiled ones via scratch buffer
+        if (grid.layout == DenseGrid::LINEAR)
+            return encode_slice(z, typed_data<T>(grid.voxel_data) + z * slice_size);
+        std::vector<T> slice(slice_size);
+        encode_slice(z, slice.data());
+        store_slice(grid, z, slice.data());
+    });
+}
+
+DenseGrid::DenseGrid() : Grid(), n_voxels(0), min_value(0), max_value(0), format(UINT8), layout(LINEAR) { select_lookup(); }
+
+DenseGrid::DenseGrid(const Grid& grid, Format format, Layout layout) :
+    Grid(grid),
+    n_voxels(grid.index_extent()),
+    min_value(std::get<0>(grid.minorant_majorant())),
+    max_value(std::get<1>(grid.minorant_majorant())),
+    format(format),
+    layout(layout)
+{
+    // encode dense grid data in the requested format, bulk copy slice-wise from source grid
+    const size_t slice_size = size_t(n_voxels.x) * n_voxels.y;
+    dispatch(format, [&](auto type) {
+        using T = decltype(type);
+        encode_slices<T>(*this, [&](uint32_t z, T* slice) {
+            if constexpr (std::is_same_v<T, uint8_t>) {
+                grid.copy_region(glm::uvec3(0, 0, z), glm::uvec3(n_voxels.x, n_voxels.y, z + 1), slice);
+            } else {
+                std::vector<float> values(slice_size);
+                grid.copy_region(glm::uvec3(0, 0, z), glm::uvec3(n_voxels.x, n_voxels.y, z + 1), values.data());
+                for (size_t i = 0; i < slice_size; ++i)
+                    slice[i] = encode_voxel<T>(values[i], min_value, max_value);
             }
+        });
     });
+    select_lookup();
 }
 
-DenseGrid::DenseGrid(const std::shared_ptr<Grid>& grid) : DenseGrid(*grid) {}
+DenseGrid::DenseGrid(const std::shared_ptr<Grid>& grid, Format format, Layout layout) : DenseGrid(*grid, format, layout) {}
 
-DenseGrid::DenseGrid(size_t w, size_t h, size_t d, const uint8_t* data) :
+DenseGrid::DenseGrid(size_t w, size_t h, size_t d, const uint8_t* data, Layout layout) :
     Grid(),
     n_voxels(w, h, d),
     min_value(0),
-    max_value(1)
+    max_value(1),
+    format(UINT8),
+    layout(layout)
 {
     // parallel copy voxel data
-    std::vector<uint32_t> slices(n_voxels.z);
-    std::iota(slices.begin(), slices.end(), 0);
-    voxel_data.resize(n_voxels.x * n_voxels.y * n_voxels.z);
-    std::for_each(std::execution::par_unseq, slices.begin(), slices.end(),
-    [&](uint32_t z)
-    {
-        for (uint32_t y = 0; y < n_voxels.y; ++y)
-            for (uint32_t x = 0; x < n_voxels.x; ++x) {
-                const size_t idx = z * n_voxels.x * n_voxels.y + y * n_voxels.x + x;
-                voxel_data[idx] = data[idx];
-            }
+    const size_t slice_size = size_t(n_voxels.x) * n_voxels.y;
+    encode_slices<uint8_t>(*this, [&](uint32_t z, uint8_t* slice) {
+        std::memcpy(slice, data + z * slice_size, slice_size);
+    });
+    select_lookup();
+}
+
+DenseGrid::DenseGrid(size_t w, size_t h, size_t d, const uint16_t* data, Layout layout) :
+    Grid(),
+    n_voxels(w, h, d),
+    min_value(0),
+    max_value(1),
+    format(UINT16),
+    layout(layout)
+{
+    // parallel copy voxel data
+    const size_t slice_size = size_t(n_voxels.x) * n_voxels.y;
+    encode_slices<uint16_t>(*this, [&](uint32_t z, uint16_t* slice) {
+        std::memcpy(slice, data + z * slice_size, slice_size * sizeof(uint16_t));
     });
+    select_lookup();
 }
 
-DenseGrid::DenseGrid(size_t w, size_t h, size_t d, const float* data) :
+DenseGrid::DenseGrid(size_t w, size_t h, size_t d, const float* data, Format format, Layout layout) :
     Grid(),
     n_voxels(w, h, d),
     min_value(FLT_MAX),
-    max_value(FLT_MIN)
+    max_value(-FLT_MAX),
+    format(format),
+    layout(layout)
 {
     // prepare slices
     std::vector<uint32_t> slices(n_voxels.z);
     std::iota(slices.begin(), slices.end(), 0);
     // pass to find global minorant and majorant
     std::vector<float> minima(n_voxels.z, FLT_MAX);
-    std::vector<float> maxima(n_voxels.z, FLT_MIN);
+    std::vector<float> maxima(n_voxels.z, -FLT_MAX);
+    const size_t slice_size = size_t(n_voxels.x) * n_voxels.y;
     std::for_each(std::execution::par_unseq, slices.begin(), slices.end(),
     [&](uint32_t z)
     {
-        for (uint32_t y = 0; y < n_voxels.y; ++y)
-            for (uint32_t x = 0; x < n_voxels.x; ++x) {
-                const float value = data[z * n_voxels.x * n_voxels.y + y * n_voxels.x + x];
-                minima[z] = std::min(minima[z], value);
-                maxima[z] = std::max(maxima[z], value);
-            }
+        reduce_min_max(data + z * slice_size, slice_size, minima[z], maxima[z]);
     });
     // reduce
     for (uint32_t z = 0; z < n_voxels.z; ++z) {
         min_value = std::min(min_value, minima[z]);
         max_value = std::max(max_value, maxima[z]);
     }
-    // encode dense grid data with 8bit per voxel
-    voxel_data.resize(n_voxels.x * n_voxels.y * n_voxels.z);
-    std::for_each(std::execution::par_unseq, slices.begin(), slices.end(),
-    [&](uint32_t z)
-    {
-        for (uint32_t y = 0; y < n_voxels.y; ++y)
-            for (uint32_t x = 0; x < n_voxels.x; ++x) {
-                const size_t idx = z * n_voxels.x * n_voxels.y + y * n_voxels.x + x;
-                voxel_data[idx] = uint8_t(std::round(255 * (data[idx] - min_value) / (max_value - min_value)));
+    // encode dense grid data in the requested format
+    dispatch(format, [&](auto type) {
+        using T = decltype(type);
+        encode_slices<T>(*this, [&](uint32_t z, T* slice) {
+            if constexpr (std::is_same_v<T, uint8_t>) {
+                quantize_u8_batch(data + z * slice_size, slice_size, min_value, max_value, slice);
+            } else {
+                for (size_t i = 0; i < slice_size; ++i)
+                    slice[i] = encode_voxel<T>(data[z * slice_size + i], min_value, max_value);
             }
+        });
     });
+    select_lookup();
+}
+
+DenseGrid::DenseGrid(size_t w, size_t h, size_t d, Buffer<uint8_t>&& data, Format format) :
+    Grid(),
+    n_voxels(w, h, d),
+    min_value(0),
+    max_value(1),
+    format(format),
+    layout(LINEAR)
+{
+    if (data.size() < size_bytes())
+        throw std::runtime_error("DenseGrid: buffer of " + std::to_string(data.size()) + " bytes too small for " + std::to_string(size_bytes()) + " bytes of voxel data");
+    voxel_data = std::move(data);
+    if (format == FLOAT16 || format == FLOAT32) compute_value_range();
+    select_lookup();
+}
+
+DenseGrid::DenseGrid(size_t w, size_t h, size_t d, std::vector<uint8_t>&& data, Format format) :
+    Grid(),
+    n_voxels(w, h, d),
+    min_value(0),
+    max_value(1),
+    format(format),
+    layout(LINEAR)
+{
+    if (data.size() < size_bytes())
+        throw std::runtime_error("DenseGrid: buffer of " + std::to_string(data.size()) + " bytes too small for " + std::to_string(size_bytes()) + " bytes of voxel data");
+    // the vector cannot move into a Buffer, share its storage instead
+    auto owner = std::make_shared<std::vector<uint8_t>>(std::move(data));
+    external_data = std::shared_ptr<const uint8_t>(owner, owner->data());
+    if (format == FLOAT16 || format == FLOAT32) compute_value_range();
+    select_lookup();
+}
+
+DenseGrid::DenseGrid(size_t w, size_t h, size_t d, const std::shared_ptr<const uint8_t>& data, Format format) :
+    Grid(),
+    n_voxels(w, h, d),
+    min_value(0),
+    max_value(1),
+    format(format),
+    layout(LINEAR),
+    external_data(data)
+{
+    if (!external_data)
+        throw std::runtime_error("DenseGrid: external voxel data must not be null");
+    if (format == FLOAT16 || format == FLOAT32) compute_value_range();
+    select_lookup();
 }
 
 DenseGrid::~DenseGrid() {}
 
-float DenseGrid::lookup(const glm::uvec3& ipos) const {
+float DenseGrid::lookup(const glm::uvec3& ipos) const { return (this->*lookup_fn)(ipos); }
+
+template <typename T> float DenseGrid::lookup_voxel(const glm::uvec3& ipos) const {
     if (glm::any(glm::greaterThanEqual(ipos, n_voxels))) return 0.f;
-    const size_t idx = ipos.z * n_voxels.x * n_voxels.y + ipos.y * n_voxels.x + ipos.x;
-    return min_value + (voxel_data[idx] / 255.f) * (max_value - min_value);
+    return decode_voxel(typed_data<T>(raw_data())[voxel_index(ipos)], min_value, max_value);
+}
+
+void DenseGrid::select_lookup() {
+    lookup_fn = dispatch(format, [](auto type) { return &DenseGrid::lookup_voxel<decltype(type)>; });
+}
+
+void DenseGrid::lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const {
+    dispatch(format, [&](auto type) {
+        const auto* data = typed_data<decltype(type)>(raw_data());
+        for (size_t i = 0; i < n; ++i) {
+            if (glm::any(glm::greaterThanEqual(ipos[i], n_voxels))) {
+                values[i] = 0.f;
+                continue;
+            }
+            values[i] = decode_voxel(data[voxel_index(ipos[i])], min_value, max_value);
+        }
+    });
+}
+
+void DenseGrid::copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // decode row-wise in contiguous runs, voxels outside of the grid are zero
+    const glm::uvec3 size = max - min;
+    const uint32_t n_inside = min.x < n_voxels.x ? std::min(max.x, n_voxels.x) - min.x : 0;
+    dispatch(format, [&](auto type) {
+        const auto* data = typed_data<decltype(type)>(raw_data());
+        for (uint32_t z = 0; z < size.z; ++z) {
+            for (uint32_t y = 0; y < size.y; ++y) {
+                float* row = dst + (size_t(z) * size.y + y) * size.x;
+                const glm::uvec3 at = min + glm::uvec3(0, y, z);
+                uint32_t x = 0;
+                if (n_inside > 0 && at.y < n_voxels.y && at.z < n_voxels.z) {
+                    while (x < n_inside) {
+                        const glm::uvec3 run_at = at + glm::uvec3(x, 0, 0);
+                        const uint32_t run_end = std::min(x + contiguous_voxels(run_at), n_inside);
+                        const auto* src = data + voxel_index(run_at);
+                        for (uint32_t i = 0; x < run_end; ++x, ++i)
+                            row[x] = decode_voxel(src[i], min_value, max_value);
+                    }
+                }
+                std::fill(row + x, row + size.x, 0.f);
+            }
+        }
+    });
+}
+
+void DenseGrid::copy_region(const glm::uvec3& min, const glm::uvec3& max, uint8_t* dst) const {
+    // decode and requantize other formats
+    if (format != UINT8) return Grid::copy_region(min, max, dst);
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // copy row-wise in contiguous runs, voxels outside of the grid are zero
+    const glm::uvec3 size = max - min;
+    const uint32_t n_inside = min.x < n_voxels.x ? std::min(max.x, n_voxels.x) - min.x : 0;
+    const uint8_t zero = quantize_u8(0.f, min_value, max_value);
+    for (uint32_t z = 0; z < size.z; ++z) {
+        for (uint32_t y = 0; y < size.y; ++y) {
+            uint8_t* row = dst + (size_t(z) * size.y + y) * size.x;
+            const glm::uvec3 at = min + glm::uvec3(0, y, z);
+            uint32_t x = 0;
+            if (n_inside > 0 && at.y < n_voxels.y && at.z < n_voxels.z) {
+                while (x < n_inside) {
+                    const glm::uvec3 run_at = at + glm::uvec3(x, 0, 0);
+                    const uint32_t n = std::min(contiguous_voxels(run_at), n_inside - x);
+                    std::memcpy(row + x, raw_data() + voxel_index(run_at), n);
+                    x += n;
+                }
+            }
+            std::fill(row + x, row + size.x, zero);
+        }
+    }
+}
+
+void DenseGrid::for_each_active_block(const BlockCallback& callback) const {
+    // scan tiles and report those exceeding the minimum value, tile rows are contiguous in both layouts
+    dispatch(format, [&](auto type) {
+        const auto* data = typed_data<decltype(type)>(raw_data());
+        for (uint32_t tz = 0; tz < n_voxels.z; tz += TILE_SIZE) {
+            for (uint32_t ty = 0; ty < n_voxels.y; ty += TILE_SIZE) {
+                for (uint32_t tx = 0; tx < n_voxels.x; tx += TILE_SIZE) {
+                    const glm::uvec3 tile_min = glm::uvec3(tx, ty, tz);
+                    const glm::uvec3 tile_max = glm::min(tile_min + TILE_SIZE, n_voxels);
+                    float value_min = FLT_MAX, value_max = -FLT_MAX;
+                    for (uint32_t z = tile_min.z; z < tile_max.z; ++z) {
+                        for (uint32_t y = tile_min.y; y < tile_max.y; ++y) {
+                            const auto* row = data + voxel_index(glm::uvec3(tile_min.x, y, z));
+                            for (uint32_t x = 0; x < tile_max.x - tile_min.x; ++x) {
+                                const float value = decode_voxel(row[x], min_value, max_value);
+                                value_min = std::min(value_min, value);
+                                value_max = std::max(value_max, value);
+                            }
+                        }
+                    }
+                    if (value_max > min_value)
+                        callback(tile_min, tile_max, value_min, value_max);
+                }
+            }
+        }
+    });
 }
 
 std::pair<float, float> DenseGrid::minorant_majorant() const { return { min_value, max_value }; }
@@ -108,6 +346,57 @@ glm::uvec3 DenseGrid::index_extent() const { return n_voxels; }
 
 size_t DenseGrid::num_voxels() const { return size_t(n_voxels.x) * n_voxels.y * n_voxels.z; }
 
-size_t DenseGrid::size_bytes() const { return size_t(n_voxels.x) * n_voxels.y * n_voxels.z; }
+size_t DenseGrid::size_bytes() const { return num_stored_voxels() * bytes_per_voxel(format); }
+
+std::string DenseGrid::to_string(const std::string& indent) const {
+    static const char* format_names[] = { "uint8", "uint16", "float16", "float32" };
+    static const char* layout_names[] = { "linear", "tiled" };
+    std::stringstream out;
+    out << Grid::to_string(indent) << std::endl;
+    out << indent << "storage format: " << format_names[format] << ", layout: " << layout_names[layout];
+    return out.str();
+}
+
+size_t DenseGrid::bytes_per_voxel(Format format) {
+    return dispatch(format, [](auto type) { return sizeof(type); });
+}
+
+void DenseGrid::compute_value_range() {
+    // parallel pass over the stored (raw) values
+    std::vector<uint32_t> slices(n_voxels.z);
+    std::iota(slices.begin(), slices.end(), 0);
+    std::vector<float> minima(n_voxels.z, FLT_MAX);
+    std::vector<float> maxima(n_voxels.z, -FLT_MAX);
+    const size_t slice_size = size_t(n_voxels.x) * n_voxels.y;
+    dispatch(format, [&](auto type) {
+        const auto* data = typed_data<decltype(type)>(raw_data());
+        std::for_each(std::execution::par_unseq, slices.begin(), slices.end(),
+        [&](uint32_t z)
+        {
+            if constexpr (std::is_same_v<decltype(type), float>) {
+                reduce_min_max(data + z * slice_size, slice_size, minima[z], maxima[z]);
+            } else {
+                for (size_t i = 0; i < slice_size; ++i) {
+                    const float value = decode_voxel(data[z * slice_size + i], 0.f, 1.f);
+                    minima[z] = std::min(minima[z], value);
+                    maxima[z] = std::max(maxima[z], value);
+                }
+            }
+        });
+    });
+    // reduce
+    min_value = n_voxels.z > 0 ? FLT_MAX : 0.f;
+    max_value = n_voxels.z > 0 ? -FLT_MAX : 0.f;
+    for (uint32_t z = 0; z < n_voxels.z; ++z) {
+        min_value = std::min(min_value, minima[z]);
+        max_value = std::max(max_value, maxima[z]);
+    }
+}
+
+size_t DenseGrid::num_stored_voxels() const {
+    if (layout == LINEAR) return num_voxels();
+    const glm::uvec3 n_tiles = (n_voxels + TILE_SIZE - 1u) / TILE_SIZE;
+    return size_t(n_tiles.x) * n_tiles.y * n_tiles.z * TILE_SIZE * TILE_SIZE * TILE_SIZE;
+}
 
 }
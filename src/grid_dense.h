@@ -1,6 +1,7 @@
 #pragma once
 
 #include "grid.h"
+#include "buffer.h"
 
 #include <vector>
 #include <memory>
@@ -9,23 +10,65 @@ namespace voldata {
 
 class DenseGrid : public Grid {
 public:
+    static constexpr uint32_t LOG2_TILE_SIZE = 3;
+    static constexpr uint32_t TILE_SIZE = 1u << LOG2_TILE_SIZE;     // edge length of tiles (TILED), also the block size of active block iteration
+
+    // storage format of voxel data: quantized w.r.t. [min_value, max_value] (UINT8, UINT16) or raw values (FLOAT16, FLOAT32)
+    enum Format { UINT8, UINT16, FLOAT16, FLOAT32 };
+    // memory layout of voxel data: x-fastest over the whole grid (LINEAR) or x-fastest within contiguous TILE_SIZE^3 tiles (TILED)
+    enum Layout { LINEAR, TILED };
+
     DenseGrid();
-    DenseGrid(const Grid& grid);
-    DenseGrid(const std::shared_ptr<Grid>& grid);
-    DenseGrid(size_t w, size_t h, size_t d, const uint8_t* data);
-    DenseGrid(size_t w, size_t h, size_t d, const float* data);
+    DenseGrid(const Grid& grid, Format format = UINT8, Layout layout = LINEAR);
+    DenseGrid(const std::shared_ptr<Grid>& grid, Format format = UINT8, Layout layout = LINEAR);
+    DenseGrid(size_t w, size_t h, size_t d, const uint8_t* data, Layout layout = LINEAR);      // stored as UINT8, normalized to [0, 1]
+    DenseGrid(size_t w, size_t h, size_t d, const uint16_t* data, Layout layout = LINEAR);     // stored as UINT16, normalized to [0, 1]
+    DenseGrid(size_t w, size_t h, size_t d, const float* data, Format format = UINT8, Layout layout = LINEAR);
+    // adopt raw voxel data in linear layout without copying, quantized formats are normalized to [0, 1]
+    DenseGrid(size_t w, size_t h, size_t d, Buffer<uint8_t>&& data, Format format = UINT8);
+    DenseGrid(size_t w, size_t h, size_t d, std::vector<uint8_t>&& data, Format format = UINT8);     // as above, kept as external data (default alignment)
+    // wrap externally owned (e.g. memory-mapped) raw voxel data in linear layout, kept alive by the shared pointer
+    DenseGrid(size_t w, size_t h, size_t d, const std::shared_ptr<const uint8_t>& data, Format format = UINT8);
     virtual ~DenseGrid();
 
     float lookup(const glm::uvec3& ipos) const;
+    void lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const;
+    void copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const;
+    void copy_region(const glm::uvec3& min, const glm::uvec3& max, uint8_t* dst) const;
+    void for_each_active_block(const BlockCallback& callback) const;
     std::pair<float, float> minorant_majorant() const;
     glm::uvec3 index_extent() const;
     size_t num_voxels() const;
     size_t size_bytes() const;
+    virtual std::string to_string(const std::string& indent="") const override;
+
+    static size_t bytes_per_voxel(Format format);
+    template <typename T> float lookup_voxel(const glm::uvec3& ipos) const;   // lookup decoding storage type T
+    void select_lookup();                           // select the lookup for the storage format, once constructed or loaded
+    size_t num_stored_voxels() const;               // voxels in raw_data(), including padding of partial tiles
+    void compute_value_range();                     // set min_value and max_value from the stored data (float formats)
+    inline const uint8_t* raw_data() const { return external_data ? external_data.get() : voxel_data.data(); }
+
+    // index of voxel in voxel_data w.r.t. layout, voxels are contiguous along x within a row (LINEAR) or tile row (TILED)
+    inline size_t voxel_index(const glm::uvec3& ipos) const {
+        if (layout == LINEAR) return (size_t(ipos.z) * n_voxels.y + ipos.y) * n_voxels.x + ipos.x;
+        const glm::uvec3 tile = ipos >> LOG2_TILE_SIZE, n_tiles = (n_voxels + TILE_SIZE - 1u) >> LOG2_TILE_SIZE, voxel = ipos & (TILE_SIZE - 1u);
+        const size_t tile_idx = (size_t(tile.z) * n_tiles.y + tile.y) * n_tiles.x + tile.x;
+        return (((((tile_idx << LOG2_TILE_SIZE) | voxel.z) << LOG2_TILE_SIZE) | voxel.y) << LOG2_TILE_SIZE) | voxel.x;
+    }
+    // number of voxels stored contiguously along x, starting at ipos
+    inline uint32_t contiguous_voxels(const glm::uvec3& ipos) const {
+        return layout == LINEAR ? n_voxels.x - ipos.x : TILE_SIZE - (ipos.x & (TILE_SIZE - 1u));
+    }
 
     // data
     glm::uvec3 n_voxels;
     float min_value, max_value;
-    std::vector<uint8_t> voxel_data;
+    Format format;
+    Layout layout;
+    Buffer<uint8_t> voxel_data;                     // raw voxel data, bytes_per_voxel(format) bytes per voxel
+    std::shared_ptr<const uint8_t> external_data;   // optional externally owned raw voxel data, replaces voxel_data if set
+    float (DenseGrid::*lookup_fn)(const glm::uvec3& ipos) const;    // lookup set by select_lookup()
 };
 
 }
@@ -143,6 +143,23 @@ float DICOMGrid::lookup(const glm::uvec3& ipos) const {
     return (lookup_raw(ipos) - min_value) / (max_value - min_value); // normalize to [0, 1]
 }
 
+void DICOMGrid::copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // read slice-wise with one data handler per image, voxels outside of the images are treated as in lookup_raw()
+    const glm::uvec3 size = max - min;
+    std::fill(dst, dst + size_t(size.x) * size.y * size.z, (0.f - min_value) / (max_value - min_value));
+    for (uint32_t z = min.z; z < std::min(max.z, uint32_t(dicom_images.size())); ++z) {
+        const imebra::Image image = dicom_images[z];
+        imebra::ReadingDataHandlerNumeric reader(image.getReadingDataHandler());
+        const uint32_t channels = image.getChannelsNumber();
+        for (uint32_t y = min.y; y < std::min(max.y, image.getHeight()); ++y) {
+            float* row = dst + (size_t(z - min.z) * size.y + y - min.y) * size.x;
+            for (uint32_t x = min.x; x < std::min(max.x, image.getWidth()); ++x)
+                row[x - min.x] = (reader.getFloat((y * image.getWidth() + x) * channels) - min_value) / (max_value - min_value);
+        }
+    }
+}
+
 float DICOMGrid::lookup_houndsfield(const glm::uvec3& ipos) const {
     return rescale_slope * lookup_raw(ipos) + rescale_intercept; // rescale to houndsfield units
 }
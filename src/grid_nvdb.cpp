@@ -1,10 +1,12 @@
 #include "grid_nvdb.h"
+#include "vdb_util.h"
+#include <cfloat>
 #include <nanovdb/util/IO.h>
 #include <nanovdb/util/GridBuilder.h>
 
 namespace voldata {
 
-NanoVDBGrid::NanoVDBGrid(const fs::path& path, const std::string& gridname) {
+NanoVDBGrid::NanoVDBGrid(const fs::path& path, const std::string& gridname) : accessor_id(next_accessor_id()) {
     handle = nanovdb::io::readGrid<nanovdb::HostBuffer>(path.string(), gridname);
     grid = handle.grid<float>();
     if (!grid || !grid->isValid() || !grid->isFogVolume())
@@ -26,21 +28,11 @@ NanoVDBGrid::NanoVDBGrid(const fs::path& path, const std::string& gridname) {
     transform[3] += transform * glm::vec4(ibb_min.x, ibb_min.y, ibb_min.z, 0);
 }
 
-NanoVDBGrid::NanoVDBGrid(const Grid& other) : Grid(other) {
-    const auto [min, maj] = other.minorant_majorant();
-    const auto isize = other.index_extent();
+NanoVDBGrid::NanoVDBGrid(const Grid& other) : Grid(other), accessor_id(next_accessor_id()) {
     // create fog volume grid
     auto builder = nanovdb::GridBuilder<float>(0.f, nanovdb::GridClass::FogVolume);
     auto acc = builder.getAccessor();
-    for (uint32_t z = 0; z < isize.z; ++z) {
-        for (uint32_t y = 0; y < isize.y; ++y) {
-            for (uint32_t x = 0; x < isize.x; ++x) {
-                const float value = other.lookup(glm::uvec3(x, y, z));
-                if (value > min)
-                    acc.setValue(nanovdb::Coord(x, y, z), value);
-            }
-        }
-    }
+    copy_active_voxels(other, [&](uint32_t x, uint32_t y, uint32_t z, float value) { acc.setValue(nanovdb::Coord(x, y, z), value); });
     handle = builder.getHandle<>();
     grid = handle.grid<float>();
     if (!grid || !grid->isValid() || !grid->isFogVolume())
@@ -62,8 +54,84 @@ NanoVDBGrid::NanoVDBGrid(const std::shared_ptr<Grid>& other) : NanoVDBGrid(*othe
 NanoVDBGrid::~NanoVDBGrid() {}
 
 float NanoVDBGrid::lookup(const glm::uvec3& ipos) const {
-    const auto acc = grid->getAccessor();
-    return acc.getValue(nanovdb::Coord(ipos.x + ibb_min.x, ipos.y + ibb_min.y, ipos.z + ibb_min.z));
+    return accessor().getValue(nanovdb::Coord(ipos.x + ibb_min.x, ipos.y + ibb_min.y, ipos.z + ibb_min.z));
+}
+
+const nanovdb::DefaultReadAccessor<float>& NanoVDBGrid::accessor() const {
+    return cached_accessor<nanovdb::DefaultReadAccessor<float>>(accessor_id, grid->tree().root());
+}
+
+void NanoVDBGrid::lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const {
+    // process queries grouped by leaf node with the cached accessor to benefit from its node cache
+    const std::vector<size_t> order = block_order(ipos, n, 3);
+    const auto& acc = accessor();
+    for (size_t i = 0; i < n; ++i) {
+        const size_t j = order.empty() ? i : order[i];
+        values[j] = acc.getValue(nanovdb::Coord(ipos[j].x + ibb_min.x, ipos[j].y + ibb_min.y, ipos[j].z + ibb_min.z));
+    }
+}
+
+void NanoVDBGrid::copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // iterate region in leaf node sized blocks, copy from leaf nodes or fill with tile value
+    const glm::uvec3 size = max - min;
+    const glm::ivec3 vmin = glm::ivec3(min) + ibb_min, vmax = glm::ivec3(max) + ibb_min;
+    const auto& acc = accessor();
+    for (int bz = vmin.z & ~7; bz < vmax.z; bz += 8) {
+        for (int by = vmin.y & ~7; by < vmax.y; by += 8) {
+            for (int bx = vmin.x & ~7; bx < vmax.x; bx += 8) {
+                const glm::ivec3 lo = glm::max(glm::ivec3(bx, by, bz), vmin), hi = glm::min(glm::ivec3(bx, by, bz) + 8, vmax);
+                const auto* leaf = acc.probeLeaf(nanovdb::Coord(bx, by, bz));
+                const float tile = leaf ? 0.f : acc.getValue(nanovdb::Coord(bx, by, bz));
+                for (int z = lo.z; z < hi.z; ++z) {
+                    for (int y = lo.y; y < hi.y; ++y) {
+                        float* row = dst + (size_t(z - vmin.z) * size.y + y - vmin.y) * size.x;
+                        for (int x = lo.x; x < hi.x; ++x)
+                            row[x - vmin.x] = leaf ? leaf->getValue(nanovdb::Coord(x, y, z)) : tile;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void NanoVDBGrid::for_each_active_block(const BlockCallback& callback) const {
+    // report block clipped to the index-space extent, given in grid coordinates
+    const auto report = [&](const nanovdb::Coord& origin, uint32_t dim, float block_min, float block_max) {
+        if (!(block_max > minorant)) return;
+        const glm::ivec3 vmin = glm::ivec3(origin[0], origin[1], origin[2]) - ibb_min;
+        const glm::uvec3 lo = glm::uvec3(glm::max(vmin, glm::ivec3(0)));
+        const glm::uvec3 hi = glm::uvec3(glm::clamp(vmin + int(dim), glm::ivec3(0), glm::ivec3(extent)));
+        if (glm::all(glm::lessThan(lo, hi)))
+            callback(lo, hi, block_min, block_max);
+    };
+    // leaf nodes (including inactive voxels)
+    const auto& tree = grid->tree();
+    const auto* leaves = tree.getFirstLeaf();
+    for (uint32_t i = 0; i < tree.nodeCount(0); ++i) {
+        float leaf_min = FLT_MAX, leaf_max = -FLT_MAX;
+        for (uint32_t j = 0; j < leaves[i].voxelCount(); ++j) {
+            leaf_min = std::min(leaf_min, leaves[i].getValue(j));
+            leaf_max = std::max(leaf_max, leaves[i].getValue(j));
+        }
+        report(leaves[i].origin(), leaves[i].dim(), leaf_min, leaf_max);
+    }
+    // tiles of lower and upper internal nodes
+    const auto* lowers = tree.getFirstLower();
+    for (uint32_t i = 0; i < tree.nodeCount(1); ++i)
+        for (auto it = lowers[i].beginValue(); it; ++it)
+            report(lowers[i].offsetToGlobalCoord(it.pos()), nanovdb::NanoLeaf<float>::dim(), *it, *it);
+    const auto* uppers = tree.getFirstUpper();
+    for (uint32_t i = 0; i < tree.nodeCount(2); ++i)
+        for (auto it = uppers[i].beginValue(); it; ++it)
+            report(uppers[i].offsetToGlobalCoord(it.pos()), nanovdb::NanoLower<float>::dim(), *it, *it);
+    // tiles of root node
+    const auto& root = tree.root();
+    for (uint32_t i = 0; i < root.tileCount(); ++i) {
+        const auto* tile = root.data()->tile(i);
+        if (!tile->isChild())
+            report(tile->origin(), nanovdb::NanoUpper<float>::dim(), tile->value, tile->value);
+    }
 }
 
 std::pair<float, float> NanoVDBGrid::minorant_majorant() const {
@@ -2,10 +2,13 @@
 #include <glm/gtx/string_cast.hpp>
 
 #ifdef VOLDATA_WITH_OPENVDB
+#include "vdb_util.h"
+#include <openvdb/tools/Dense.h>
+#include <cfloat>
 
 namespace voldata {
 
-OpenVDBGrid::OpenVDBGrid(const fs::path& filename, const std::string& gridname) {
+OpenVDBGrid::OpenVDBGrid(const fs::path& filename, const std::string& gridname) : accessor_id(next_accessor_id()) {
     // open file
     openvdb::initialize();
     openvdb::io::File vdb_file(filename.string());
@@ -44,23 +47,14 @@ OpenVDBGrid::OpenVDBGrid(const fs::path& filename, const std::string& gridname)
     transform[3] += transform * glm::vec4(ibb_min.x, ibb_min.y, ibb_min.z, 0);
 }
 
-OpenVDBGrid::OpenVDBGrid(const Grid& other) : Grid(other) {
+OpenVDBGrid::OpenVDBGrid(const Grid& other) : Grid(other), accessor_id(next_accessor_id()) {
     const auto [min, maj] = other.minorant_majorant();
     // create fog volume grid
     grid = openvdb::FloatGrid::create(min);
     grid->setName("density");
     grid->setGridClass(openvdb::GRID_FOG_VOLUME);
-    const auto isize = other.index_extent();
     auto acc = grid->getAccessor();
-    for (uint32_t z = 0; z < isize.z; ++z) {
-        for (uint32_t y = 0; y < isize.y; ++y) {
-            for (uint32_t x = 0; x < isize.x; ++x) {
-                const float value = other.lookup(glm::ivec3(x, y, z));
-                if (value > min)
-                    acc.setValue(openvdb::Coord(x, y, z), value);
-            }
-        }
-    }
+    copy_active_voxels(other, [&](uint32_t x, uint32_t y, uint32_t z, float value) { acc.setValue(openvdb::Coord(x, y, z), value); });
     grid->pruneGrid();
     // compute index bounding box
     const openvdb::Coord dim = grid->evalActiveVoxelDim();
@@ -86,8 +80,61 @@ OpenVDBGrid::OpenVDBGrid(const std::shared_ptr<Grid>& other) : OpenVDBGrid(*othe
 OpenVDBGrid::~OpenVDBGrid() {}
 
 float OpenVDBGrid::lookup(const glm::uvec3& ipos) const {
-    auto acc = grid->getConstUnsafeAccessor(); // use own accessor for more perf
-    return acc.getValue(openvdb::Coord(ipos.x + ibb_min.x, ipos.y + ibb_min.y, ipos.z + ibb_min.z));
+    return accessor().getValue(openvdb::Coord(ipos.x + ibb_min.x, ipos.y + ibb_min.y, ipos.z + ibb_min.z));
+}
+
+const openvdb::FloatGrid::ConstUnsafeAccessor& OpenVDBGrid::accessor() const {
+    // unregistered accessor, the tree is not modified after construction
+    return cached_accessor<openvdb::FloatGrid::ConstUnsafeAccessor>(accessor_id, grid->constTree());
+}
+
+void OpenVDBGrid::lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const {
+    // process queries grouped by leaf node with the cached accessor to benefit from its node cache
+    const std::vector<size_t> order = block_order(ipos, n, 3);
+    const auto& acc = accessor();
+    for (size_t i = 0; i < n; ++i) {
+        const size_t j = order.empty() ? i : order[i];
+        values[j] = acc.getValue(openvdb::Coord(ipos[j].x + ibb_min.x, ipos[j].y + ibb_min.y, ipos[j].z + ibb_min.z));
+    }
+}
+
+void OpenVDBGrid::copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const {
+    if (glm::any(glm::lessThanEqual(max, min))) return;
+    // wrap dst as dense grid (x fastest) over the inclusive index bounding box and copy leaf/tile-wise
+    const openvdb::CoordBBox bbox(openvdb::Coord(min.x + ibb_min.x, min.y + ibb_min.y, min.z + ibb_min.z),
+                                  openvdb::Coord(max.x - 1 + ibb_min.x, max.y - 1 + ibb_min.y, max.z - 1 + ibb_min.z));
+    openvdb::tools::Dense<float, openvdb::tools::LayoutXYZ> dense(bbox, dst);
+    openvdb::tools::copyToDense(*grid, dense);
+}
+
+void OpenVDBGrid::for_each_active_block(const BlockCallback& callback) const {
+    // report block clipped to the index-space extent, given in grid coordinates
+    const auto report = [&](const openvdb::CoordBBox& bbox, float block_min, float block_max) {
+        if (!(block_max > minorant)) return;
+        const glm::ivec3 vmin = glm::ivec3(bbox.min().x(), bbox.min().y(), bbox.min().z()) - ibb_min;
+        const glm::ivec3 vmax = glm::ivec3(bbox.max().x(), bbox.max().y(), bbox.max().z()) + 1 - ibb_min;
+        const glm::uvec3 lo = glm::uvec3(glm::max(vmin, glm::ivec3(0)));
+        const glm::uvec3 hi = glm::uvec3(glm::clamp(vmax, glm::ivec3(0), glm::ivec3(extent)));
+        if (glm::all(glm::lessThan(lo, hi)))
+            callback(lo, hi, block_min, block_max);
+    };
+    // leaf nodes (including inactive voxels)
+    for (auto leaf = grid->tree().cbeginLeaf(); leaf; ++leaf) {
+        float leaf_min = FLT_MAX, leaf_max = -FLT_MAX;
+        for (openvdb::Index i = 0; i < leaf->SIZE; ++i) {
+            leaf_min = std::min(leaf_min, leaf->getValue(i));
+            leaf_max = std::max(leaf_max, leaf->getValue(i));
+        }
+        report(leaf->getNodeBoundingBox(), leaf_min, leaf_max);
+    }
+    // tiles of internal and root nodes
+    auto tile = grid->tree().cbeginValueAll();
+    tile.setMaxDepth(openvdb::FloatTree::ValueAllCIter::LEAF_DEPTH - 1);
+    for (; tile; ++tile) {
+        openvdb::CoordBBox bbox;
+        tile.getBoundingBox(bbox);
+        report(bbox, *tile, *tile);
+    }
 }
 
 std::pair<float, float> OpenVDBGrid::minorant_majorant() const {
@@ -19,16 +19,24 @@ public:
     virtual ~OpenVDBGrid();
 
     float lookup(const glm::uvec3& ipos) const;
+    void lookup_batch(const glm::uvec3* ipos, float* values, size_t n) const;
+    void copy_region(const glm::uvec3& min, const glm::uvec3& max, float* dst) const;
+    using Grid::copy_region;
+    void for_each_active_block(const BlockCallback& callback) const;
     std::pair<float, float> minorant_majorant() const;
     glm::uvec3 index_extent() const;
     size_t num_voxels() const;
     size_t size_bytes() const;
 
+    // per-thread cached accessor, used by lookup() to keep node caches across coherent queries
+    const openvdb::FloatGrid::ConstUnsafeAccessor& accessor() const;
+
     // write to vdb file on disk
     void write(const fs::path& path) const;
 
     // data
     openvdb::FloatGrid::Ptr grid;
+    uint64_t accessor_id;                   // unique id to key per-thread accessor caches
     glm::ivec3 ibb_min;
     glm::uvec3 extent;
     float minorant, majorant;
@@ -0,0 +1,213 @@
+#include "quantize.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define VOLDATA_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace voldata {
+
+// ----------------------------------------------
+// scalar kernels (also used for the remainders of the vector kernels)
+
+static inline float quantize_scaled(float value, float min, float scale) {
+    // same operation order as the vector kernels: scale, clamp (NaN to 0), round half up via truncation
+    float t = (value - min) * scale;
+    t = t > 0.f ? t : 0.f;
+    t = t < 255.f ? t : 255.f;
+    return t + 0.5f;
+}
+
+static void reduce_min_max_scalar(const float* values, size_t n, float& min, float& max) {
+    for (size_t i = 0; i < n; ++i) {
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+    }
+}
+
+static void merge_lanes(const float* lanes_min, const float* lanes_max, size_t n, float& min, float& max) {
+    for (size_t i = 0; i < n; ++i) {
+        min = lanes_min[i] < min ? lanes_min[i] : min;
+        max = lanes_max[i] > max ? lanes_max[i] : max;
+    }
+}
+
+static void quantize_u8_scalar(const float* values, size_t n, float min, float scale, uint8_t* dst) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = uint8_t(quantize_scaled(values[i], min, scale));
+}
+
+// ----------------------------------------------
+// x86 vector kernels
+
+#ifdef VOLDATA_X86_DISPATCH
+
+__attribute__((target("sse2")))
+static void reduce_min_max_sse2(const float* values, size_t n, float& min, float& max) {
+    __m128 vmin = _mm_set1_ps(min), vmax = _mm_set1_ps(max);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // operand order keeps the accumulator for NaN inputs
+        const __m128 v = _mm_loadu_ps(values + i);
+        vmin = _mm_min_ps(v, vmin);
+        vmax = _mm_max_ps(v, vmax);
+    }
+    float lanes_min[4], lanes_max[4];
+    _mm_storeu_ps(lanes_min, vmin);
+    _mm_storeu_ps(lanes_max, vmax);
+    merge_lanes(lanes_min, lanes_max, 4, min, max);
+    reduce_min_max_scalar(values + i, n - i, min, max);
+}
+
+__attribute__((target("sse2")))
+static void quantize_u8_sse2(const float* values, size_t n, float min, float scale, uint8_t* dst) {
+    const __m128 vmin = _mm_set1_ps(min), vscale = _mm_set1_ps(scale);
+    const __m128 zero = _mm_setzero_ps(), upper = _mm_set1_ps(255.f), half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i q[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i + 4 * k), vmin), vscale);
+            t = _mm_min_ps(_mm_max_ps(t, zero), upper);
+            q[k] = _mm_cvttps_epi32(_mm_add_ps(t, half));
+        }
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3]));
+        _mm_storeu_si128((__m128i*)(dst + i), packed);
+    }
+    quantize_u8_scalar(values + i, n - i, min, scale, dst + i);
+}
+
+__attribute__((target("avx2")))
+static void reduce_min_max_avx2(const float* values, size_t n, float& min, float& max) {
+    __m256 vmin = _mm256_set1_ps(min), vmax = _mm256_set1_ps(max);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_loadu_ps(values + i);
+        vmin = _mm256_min_ps(v, vmin);
+        vmax = _mm256_max_ps(v, vmax);
+    }
+    float lanes_min[8], lanes_max[8];
+    _mm256_storeu_ps(lanes_min, vmin);
+    _mm256_storeu_ps(lanes_max, vmax);
+    merge_lanes(lanes_min, lanes_max, 8, min, max);
+    reduce_min_max_scalar(values + i, n - i, min, max);
+}
+
+__attribute__((target("avx2")))
+static void quantize_u8_avx2(const float* values, size_t n, float min, float scale, uint8_t* dst) {
+    const __m256 vmin = _mm256_set1_ps(min), vscale = _mm256_set1_ps(scale);
+    const __m256 zero = _mm256_setzero_ps(), upper = _mm256_set1_ps(255.f), half = _mm256_set1_ps(0.5f);
+    // packs operate per 128bit lane, restore element order afterwards
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i q[4];
+        for (int k = 0; k < 4; ++k) {
+            __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(values + i + 8 * k), vmin), vscale);
+            t = _mm256_min_ps(_mm256_max_ps(t, zero), upper);
+            q[k] = _mm256_cvttps_epi32(_mm256_add_ps(t, half));
+        }
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(q[0], q[1]), _mm256_packs_epi32(q[2], q[3]));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    quantize_u8_sse2(values + i, n - i, min, scale, dst + i);
+}
+
+__attribute__((target("avx512f")))
+static void reduce_min_max_avx512(const float* values, size_t n, float& min, float& max) {
+    __m512 vmin = _mm512_set1_ps(min), vmax = _mm512_set1_ps(max);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512 v = _mm512_loadu_ps(values + i);
+        vmin = _mm512_min_ps(v, vmin);
+        vmax = _mm512_max_ps(v, vmax);
+    }
+    float lanes_min[16], lanes_max[16];
+    _mm512_storeu_ps(lanes_min, vmin);
+    _mm512_storeu_ps(lanes_max, vmax);
+    merge_lanes(lanes_min, lanes_max, 16, min, max);
+    reduce_min_max_scalar(values + i, n - i, min, max);
+}
+
+__attribute__((target("avx512f")))
+static void quantize_u8_avx512(const float* values, size_t n, float min, float scale, uint8_t* dst) {
+    const __m512 vmin = _mm512_set1_ps(min), vscale = _mm512_set1_ps(scale);
+    const __m512 zero = _mm512_setzero_ps(), upper = _mm512_set1_ps(255.f), half = _mm512_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 t = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(values + i), vmin), vscale);
+        t = _mm512_min_ps(_mm512_max_ps(t, zero), upper);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm512_cvtusepi32_epi8(_mm512_cvttps_epi32(_mm512_add_ps(t, half))));
+    }
+    quantize_u8_sse2(values + i, n - i, min, scale, dst + i);
+}
+
+#endif
+
+// ----------------------------------------------
+// runtime dispatch
+
+enum SimdLevel { SCALAR, SSE2, AVX2, AVX512 };
+static const char* SIMD_LEVEL_NAMES[] = { "scalar", "sse2", "avx2", "avx512" };
+
+static SimdLevel detect_simd_level() {
+    SimdLevel level = SCALAR;
+#ifdef VOLDATA_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) level = SSE2;
+    if (__builtin_cpu_supports("avx2")) level = AVX2;
+    if (__builtin_cpu_supports("avx512f")) level = AVX512;
+#endif
+    // optionally lower the level, e.g. for testing or to avoid frequency scaling
+    if (const char* env = std::getenv("VOLDATA_SIMD")) {
+        for (int i = 0; i < 4; ++i)
+            if (std::strcmp(env, SIMD_LEVEL_NAMES[i]) == 0)
+                level = std::min(level, SimdLevel(i));
+    }
+    return level;
+}
+
+static SimdLevel get_simd_level() {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+void reduce_min_max(const float* values, size_t n, float& min, float& max) {
+#ifdef VOLDATA_X86_DISPATCH
+    switch (get_simd_level()) {
+        case AVX512: return reduce_min_max_avx512(values, n, min, max);
+        case AVX2: return reduce_min_max_avx2(values, n, min, max);
+        case SSE2: return reduce_min_max_sse2(values, n, min, max);
+        default: break;
+    }
+#endif
+    reduce_min_max_scalar(values, n, min, max);
+}
+
+void quantize_u8_batch(const float* values, size_t n, float min, float max, uint8_t* dst) {
+    if (!(max > min)) {
+        std::memset(dst, 0, n);
+        return;
+    }
+    const float scale = 255.f / (max - min);
+#ifdef VOLDATA_X86_DISPATCH
+    switch (get_simd_level()) {
+        case AVX512: return quantize_u8_avx512(values, n, min, scale, dst);
+        case AVX2: return quantize_u8_avx2(values, n, min, scale, dst);
+        case SSE2: return quantize_u8_sse2(values, n, min, scale, dst);
+        default: break;
+    }
+#endif
+    quantize_u8_scalar(values, n, min, scale, dst);
+}
+
+const char* simd_level() {
+    return SIMD_LEVEL_NAMES[get_simd_level()];
+}
+
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace voldata {
+
+// vectorized kernels shared by grid construction, dispatched at runtime to AVX-512, AVX2, SSE2 or scalar code
+// the dispatch level can be lowered via the environment variable VOLDATA_SIMD=scalar|sse2|avx2|avx512
+
+void reduce_min_max(const float* values, size_t n, float& min, float& max);                // extend [min, max] by the values, NaNs are ignored
+void quantize_u8_batch(const float* values, size_t n, float min, float max, uint8_t* dst);  // quantize_u8() of n values, bit-exact
+const char* simd_level();                                                                   // name of the dispatched instruction set
+
+}
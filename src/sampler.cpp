@@ -0,0 +1,75 @@
+#include "sampler.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace voldata {
+
+// number of samples processed at once in batched sampling
+static const size_t BATCH_SIZE = 256;
+
+Sampler::Sampler(const std::shared_ptr<Grid>& grid, const glm::mat4& transform) :
+    grid(grid),
+    world_to_index(glm::inverse(transform)),
+    extent(grid->index_extent())
+{}
+
+Sampler::Sampler(const std::shared_ptr<Grid>& grid) : Sampler(grid, grid->transform) {}
+
+Sampler::Sampler(const Volume& volume, const std::string& gridname) : Sampler(volume.current_grid(gridname), volume.get_transform(gridname)) {}
+
+Sampler::~Sampler() {}
+
+float Sampler::sample(const glm::vec3& wpos, Filter filter) const {
+    return filter == NEAREST ? sample_nearest(wpos) : sample_trilinear(wpos);
+}
+
+float Sampler::sample_nearest(const glm::vec3& wpos) const {
+    const glm::vec3 ipos = to_index(wpos);
+    if (glm::any(glm::lessThan(ipos, glm::vec3(0))) || glm::any(glm::greaterThanEqual(ipos, glm::vec3(extent)))) return 0.f;
+    return grid->lookup(glm::uvec3(ipos));
+}
+
+float Sampler::sample_trilinear(const glm::vec3& wpos) const {
+    const glm::vec3 ipos = to_index(wpos);
+    if (glm::any(glm::lessThan(ipos, glm::vec3(0))) || glm::any(glm::greaterThanEqual(ipos, glm::vec3(extent)))) return 0.f;
+    return grid->sample_trilinear(ipos);
+}
+
+void Sampler::sample_batch(const glm::vec3* wpos, float* values, size_t n, Filter filter) const {
+    if (glm::any(glm::equal(extent, glm::uvec3(0)))) {
+        std::fill(values, values + n, 0.f);
+        return;
+    }
+    std::vector<float> px(BATCH_SIZE), py(BATCH_SIZE), pz(BATCH_SIZE);
+    std::vector<uint8_t> inside(BATCH_SIZE);
+    std::vector<glm::uvec3> positions(filter == NEAREST ? BATCH_SIZE : 0);
+    std::vector<glm::vec3> ipos(filter == NEAREST ? 0 : BATCH_SIZE);
+    const glm::vec3 fextent = glm::vec3(extent);
+    for (size_t offset = 0; offset < n; offset += BATCH_SIZE) {
+        const size_t count = std::min(BATCH_SIZE, n - offset);
+        // transform to index-space (SoA, vectorizable)
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec3& w = wpos[offset + i];
+            px[i] = world_to_index[0][0] * w.x + world_to_index[1][0] * w.y + world_to_index[2][0] * w.z + world_to_index[3][0];
+            py[i] = world_to_index[0][1] * w.x + world_to_index[1][1] * w.y + world_to_index[2][1] * w.z + world_to_index[3][1];
+            pz[i] = world_to_index[0][2] * w.x + world_to_index[1][2] * w.y + world_to_index[2][2] * w.z + world_to_index[3][2];
+            inside[i] = px[i] >= 0.f && py[i] >= 0.f && pz[i] >= 0.f && px[i] < fextent.x && py[i] < fextent.y && pz[i] < fextent.z;
+        }
+        // gather with a single batched lookup or let the grid interpolate (e.g. from a single brick)
+        if (filter == NEAREST) {
+            for (size_t i = 0; i < count; ++i)
+                positions[i] = inside[i] ? glm::uvec3(px[i], py[i], pz[i]) : glm::uvec3(0);
+            grid->lookup_batch(positions.data(), values + offset, count);
+        } else {
+            for (size_t i = 0; i < count; ++i)
+                ipos[i] = glm::vec3(px[i], py[i], pz[i]);
+            grid->sample_trilinear_batch(ipos.data(), values + offset, count);
+        }
+        // samples outside of the AABB are zero
+        for (size_t i = 0; i < count; ++i)
+            values[offset + i] = inside[i] ? values[offset + i] : 0.f;
+    }
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "grid.h"
+#include "volume.h"
+
+#include <memory>
+#include <string>
+#include <glm/glm.hpp>
+
+namespace voldata {
+
+class Sampler {
+public:
+    enum Filter { NEAREST, TRILINEAR };
+
+    Sampler(const std::shared_ptr<Grid>& grid, const glm::mat4& transform);        // transform: index- to world-space
+    Sampler(const std::shared_ptr<Grid>& grid);                                     // uses the grid's own transform
+    Sampler(const Volume& volume, const std::string& gridname = "density");        // binds the current grid frame of the volume
+    virtual ~Sampler();
+
+    // world-space sampling, zero outside of the grid's AABB
+    float sample(const glm::vec3& wpos, Filter filter = TRILINEAR) const;
+    float sample_nearest(const glm::vec3& wpos) const;
+    float sample_trilinear(const glm::vec3& wpos) const;
+    void sample_batch(const glm::vec3* wpos, float* values, size_t n, Filter filter = TRILINEAR) const;
+
+    // index-space position (voxel i covers [i, i+1)) of given world-space position
+    inline glm::vec3 to_index(const glm::vec3& wpos) const { return glm::vec3(world_to_index * glm::vec4(wpos, 1)); }
+
+    // data
+    std::shared_ptr<Grid> grid;
+    glm::mat4 world_to_index;                       // cached inverse of the index- to world-space transform
+    glm::uvec3 extent;                              // cached index extent of the grid
+};
+
+}
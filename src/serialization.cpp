@@ -1,5 +1,6 @@
 #include "serialization.h"
 #include "grid_nvdb.h"
+#include "grid_brick_paged.h"
 #ifdef VOLDATA_WITH_OPENVDB
 #include "grid_vdb.h"
 #endif
@@ -29,34 +30,111 @@ namespace cereal {
 }
 
 namespace voldata {
+    // file header: magic and format version of the grid, files without header are read as version 0
+    // the magic is a NaN as float, so it never matches the first transform entry that starts unversioned files
+    static const uint32_t FILE_MAGIC = 0x7FF05644u;
+    static const uint32_t DENSE_GRID_VERSION = 2;
+    static const uint32_t BRICK_GRID_VERSION = 5;
+
+    template <class Archive> void write_header(Archive& archive, uint32_t version) {
+        archive(FILE_MAGIC, version);
+    }
+    template <class Archive> uint32_t read_header(Archive& archive, std::istream& file, uint32_t max_version, const fs::path& path) {
+        const std::streampos start = file.tellg();
+        uint32_t magic = 0, version = 0;
+        archive(magic);
+        if (magic == FILE_MAGIC) archive(version);
+        else file.seekg(start);
+        if (version > max_version)
+            throw std::runtime_error("Unsupported grid file version " + std::to_string(version) + " in " + path.string());
+        return version;
+    }
+
     // buf3d
     template <class Archive, typename T> void serialize(Archive& archive, Buf3D<T>& buf) {
         archive(buf.stride, buf.data);
     }
 
-    // dense grid
-    template <class Archive> void serialize(Archive& archive, DenseGrid& grid) {
+    // dense grid (version 0: implicit uint8 format, version 1: implicit linear layout)
+    template <class Archive> void save_grid(Archive& archive, const DenseGrid& grid) {
+        // write raw data in the layout of std::vector<uint8_t>, also for external buffers
+        archive(grid.transform, grid.n_voxels, grid.min_value, grid.max_value);
+        archive(cereal::make_size_tag(static_cast<cereal::size_type>(grid.size_bytes())), cereal::binary_data(grid.raw_data(), grid.size_bytes()));
+        archive(grid.format, grid.layout);
+    }
+    template <class Archive> void load_grid(Archive& archive, DenseGrid& grid, const uint32_t version) {
+        grid.external_data.reset();
+        if (version < 1) grid.format = DenseGrid::UINT8;
+        if (version < 2) grid.layout = DenseGrid::LINEAR;
         archive(grid.transform, grid.n_voxels, grid.min_value, grid.max_value, grid.voxel_data);
+        if (version >= 1) archive(grid.format);
+        if (version >= 2) archive(grid.layout);
+        grid.select_lookup();
     }
 
-    // brick grid
-    template <class Archive> void serialize(Archive& archive, BrickGrid& grid) {
+    // brick grid (version 0: implicit packed pointers and 3 mipmap levels), fields of newer versions are appended
+    template <class Archive, uint32_t LOG2_BRICK_SIZE> void serialize_grid(Archive& archive, BrickGridT<LOG2_BRICK_SIZE>& grid, const uint32_t version) {
         archive(grid.transform, grid.n_bricks, grid.min_maj, grid.brick_counter, grid.indirection, grid.range, grid.atlas, grid.range_mipmaps);
+        if (version >= 1) archive(grid.pointer_mode);
+        else grid.pointer_mode = BrickGridT<LOG2_BRICK_SIZE>::PACKED;
+        if (version >= 2) archive(grid.active_counter);
+        else grid.active_counter = size_t(grid.brick_counter);
+        if (version >= 3) archive(grid.unit_counter, grid.tolerance);
+        else grid.unit_counter = grid.atlas.data.size() / (grid.VOXELS_PER_BRICK / 8);
+        if (version >= 4) archive(grid.apron);
+        else grid.apron = 0;
+        if (version >= 5) archive(grid.dilation, grid.sparsity_threshold);
+        else { grid.dilation = 2; grid.sparsity_threshold = -FLT_MAX; }
+    }
+    template <class Archive, uint32_t LOG2_BRICK_SIZE> void save_grid(Archive& archive, BrickGridT<LOG2_BRICK_SIZE>& grid) {
+        serialize_grid(archive, grid, BRICK_GRID_VERSION);
+    }
+    template <class Archive, uint32_t LOG2_BRICK_SIZE> void load_grid(Archive& archive, BrickGridT<LOG2_BRICK_SIZE>& grid, const uint32_t version) {
+        serialize_grid(archive, grid, version);
+    }
+
+    // brick grid without atlas data, read in the layout of the brick grid above, returns the file offset of the atlas data
+    template <class Archive, uint32_t LOG2_BRICK_SIZE> size_t load_grid_header(Archive& archive, BrickGridT<LOG2_BRICK_SIZE>& grid, std::istream& file, const uint32_t version) {
+        archive(grid.transform, grid.n_bricks, grid.min_maj, grid.brick_counter, grid.indirection, grid.range);
+        // keep the atlas layout, record the position of its data and skip it
+        cereal::size_type atlas_bytes;
+        archive(grid.atlas.stride, cereal::make_size_tag(atlas_bytes));
+        const size_t atlas_offset = file.tellg();
+        file.seekg(atlas_bytes, std::ios::cur);
+        archive(grid.range_mipmaps);
+        if (version >= 1) archive(grid.pointer_mode);
+        else grid.pointer_mode = BrickGridT<LOG2_BRICK_SIZE>::PACKED;
+        if (version >= 2) archive(grid.active_counter);
+        else grid.active_counter = size_t(grid.brick_counter);
+        if (version >= 3) archive(grid.unit_counter, grid.tolerance);
+        else grid.unit_counter = atlas_bytes / (grid.VOXELS_PER_BRICK / 8);
+        if (version >= 4) archive(grid.apron);
+        else grid.apron = 0;
+        if (version >= 5) archive(grid.dilation, grid.sparsity_threshold);
+        else { grid.dilation = 2; grid.sparsity_threshold = -FLT_MAX; }
+        return atlas_offset;
     }
 
     // general write func
-    template <typename T> void write(const T& data, const fs::path& path) {
+    template <typename T> void write(T& grid, uint32_t version, const fs::path& path) {
         std::ofstream file(path, std::ios::binary);
         cereal::PortableBinaryOutputArchive archive(file);
-        archive(data);
+        write_header(archive, version);
+        save_grid(archive, grid);
         std::cout << path << " written." << std::endl;
     }
 
     void write_grid(const std::shared_ptr<Grid>& grid, const fs::path& path) {
         if(DenseGrid* dense = dynamic_cast<DenseGrid*>(grid.get()))
-            write<DenseGrid>(*dense, path);
+            write(*dense, DENSE_GRID_VERSION, path);
+        else if(dynamic_cast<PagedBrickGrid*>(grid.get()) || dynamic_cast<PagedBrickGrid4*>(grid.get()) || dynamic_cast<PagedBrickGrid16*>(grid.get()))
+            throw std::runtime_error("Paged brick grids are read-only, write the source grid instead!");
         else if(BrickGrid* brick = dynamic_cast<BrickGrid*>(grid.get()))
-            write<BrickGrid>(*brick, path);
+            write(*brick, BRICK_GRID_VERSION, path);
+        else if(BrickGrid4* brick = dynamic_cast<BrickGrid4*>(grid.get()))
+            write(*brick, BRICK_GRID_VERSION, path);
+        else if(BrickGrid16* brick = dynamic_cast<BrickGrid16*>(grid.get()))
+            write(*brick, BRICK_GRID_VERSION, path);
 #ifdef VOLDATA_WITH_OPENVDB
         else if(OpenVDBGrid* vdb = dynamic_cast<OpenVDBGrid*>(grid.get()))
             vdb->write(path); // write out vdb file
@@ -71,15 +149,53 @@ namespace voldata {
         std::ifstream file(path, std::ios::binary);
         cereal::PortableBinaryInputArchive archive(file);
         std::shared_ptr<DenseGrid> grid = std::make_shared<DenseGrid>();
-        archive(*grid.get());
+        load_grid(archive, *grid, read_header(archive, file, DENSE_GRID_VERSION, path));
         return grid;
     }
 
-    std::shared_ptr<BrickGrid> load_brick_grid(const fs::path& path) {
+    template <uint32_t LOG2_BRICK_SIZE>
+    void check_brick_grid_layout(BrickGridT<LOG2_BRICK_SIZE>& grid, const fs::path& path) {
+        // brick size is not stored, check against the atlas layout (only pruned in z)
+        const uint32_t atlas_width = grid.pointer_mode == grid.PACKED ? grid.n_bricks.x * grid.stored_size() :
+                                     grid.pointer_mode == grid.WIDE ? grid.encoded_bytes(3) : grid.VOXELS_PER_BRICK / 8;
+        if (grid.apron > 1 || grid.dilation < grid.apron || (grid.apron && grid.pointer_mode == grid.VARIABLE) || grid.atlas.size().x != atlas_width)
+            throw std::runtime_error("Brick grid layout mismatch in " + path.string());
+        // each mipmap level halves the previous one, rebuild truncated hierarchies (fixed depth of 3 in older files)
+        glm::uvec3 size = grid.n_bricks;
+        for (const auto& mip : grid.range_mipmaps) {
+            size = (size + 1u) / 2u;
+            if (mip.size() != size)
+                throw std::runtime_error("Brick grid mipmap mismatch in " + path.string());
+        }
+        if (glm::any(glm::greaterThan(size, glm::uvec3(1))))
+            grid.build_mipmaps();
+        grid.select_lookup();
+    }
+
+    template <uint32_t LOG2_BRICK_SIZE>
+    std::shared_ptr<BrickGridT<LOG2_BRICK_SIZE>> load_brick_grid(const fs::path& path) {
         std::ifstream file(path, std::ios::binary);
         cereal::PortableBinaryInputArchive archive(file);
-        std::shared_ptr<BrickGrid> grid = std::make_shared<BrickGrid>();
-        archive(*grid.get());
+        auto grid = std::make_shared<BrickGridT<LOG2_BRICK_SIZE>>();
+        load_grid(archive, *grid, read_header(archive, file, BRICK_GRID_VERSION, path));
+        check_brick_grid_layout(*grid, path);
         return grid;
     }
+
+    template <uint32_t LOG2_BRICK_SIZE>
+    size_t load_brick_grid_header(const fs::path& path, BrickGridT<LOG2_BRICK_SIZE>& grid) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("Unable to open " + path.string());
+        cereal::PortableBinaryInputArchive archive(file);
+        const size_t atlas_offset = load_grid_header(archive, grid, file, read_header(archive, file, BRICK_GRID_VERSION, path));
+        check_brick_grid_layout(grid, path);
+        return atlas_offset;
+    }
+
+    template std::shared_ptr<BrickGridT<2>> load_brick_grid<2>(const fs::path& path);
+    template std::shared_ptr<BrickGridT<3>> load_brick_grid<3>(const fs::path& path);
+    template std::shared_ptr<BrickGridT<4>> load_brick_grid<4>(const fs::path& path);
+    template size_t load_brick_grid_header<2>(const fs::path& path, BrickGridT<2>& grid);
+    template size_t load_brick_grid_header<3>(const fs::path& path, BrickGridT<3>& grid);
+    template size_t load_brick_grid_header<4>(const fs::path& path, BrickGridT<4>& grid);
 }
@@ -14,6 +14,9 @@ namespace voldata {
 
     void write_grid(const std::shared_ptr<Grid>& grid, const fs::path& path);
     std::shared_ptr<DenseGrid> load_dense_grid(const fs::path& path);
-    std::shared_ptr<BrickGrid> load_brick_grid(const fs::path& path);
+    template <uint32_t LOG2_BRICK_SIZE = 3>
+    std::shared_ptr<BrickGridT<LOG2_BRICK_SIZE>> load_brick_grid(const fs::path& path);    // instantiated for BrickGrid, BrickGrid4 and BrickGrid16
+    template <uint32_t LOG2_BRICK_SIZE = 3>
+    size_t load_brick_grid_header(const fs::path& path, BrickGridT<LOG2_BRICK_SIZE>& grid);  // load all but the atlas data, returns its file offset (paged grids)
 
 } // namespace voldata
@@ -0,0 +1,120 @@
+#include "statistics.h"
+
+#include <cmath>
+#include <cfloat>
+#include <sstream>
+#include <numeric>
+#include <algorithm>
+#include <execution>
+
+namespace voldata {
+
+// rows fetched per copy_region call, bounds the per-thread scratch buffer
+static const uint32_t ROWS_PER_READ = 8;
+
+// count, mean and sum of squared deviations of a set of values, merged pairwise (Chan et al.) to avoid cancellation
+struct Moments {
+    double n = 0.0, mean = 0.0, m2 = 0.0;
+
+    void merge(const Moments& other) {
+        if (other.n == 0.0) return;
+        const double total = n + other.n, delta = other.mean - mean;
+        mean += delta * (other.n / total);
+        m2 += other.m2 + delta * delta * (n * other.n / total);
+        n = total;
+    }
+};
+
+GridStatistics compute_statistics(const Grid& grid, uint32_t bins) {
+    const glm::uvec3 extent = grid.index_extent();
+    const float min = grid.minorant_majorant().first, max = grid.minorant_majorant().second;
+    GridStatistics stats;
+    stats.min = min;
+    stats.max = max;
+    stats.histogram.assign(std::max(bins, 1u), 0);
+    stats.mean = stats.variance = 0;
+    stats.n_voxels = size_t(extent.x) * extent.y * extent.z;
+    stats.n_active = 0;
+    if (stats.n_voxels == 0) return stats;
+
+    // prepare slices
+    std::vector<uint32_t> slices(extent.z);
+    std::iota(slices.begin(), slices.end(), 0);
+    // per slice partial results, NaN voxels count as the minorant
+    const size_t n_bins = stats.histogram.size();
+    const float bin_scale = max > min ? n_bins / (max - min) : 0.f;
+    std::vector<size_t> partial_histograms(n_bins * extent.z, 0);
+    std::vector<Moments> partial_moments(extent.z);
+    std::vector<size_t> partial_active(extent.z, 0);
+    std::for_each(std::execution::par_unseq, slices.begin(), slices.end(),
+    [&](uint32_t z)
+    {
+        std::vector<float> values(size_t(extent.x) * ROWS_PER_READ);
+        std::vector<uint32_t> bin_ids(extent.x);
+        size_t* histogram = partial_histograms.data() + size_t(z) * n_bins;
+        for (uint32_t y0 = 0; y0 < extent.y; y0 += ROWS_PER_READ) {
+            const uint32_t y1 = std::min(y0 + ROWS_PER_READ, extent.y);
+            grid.copy_region(glm::uvec3(0, y0, z), glm::uvec3(extent.x, y1, z + 1), values.data());
+            for (uint32_t y = 0; y < y1 - y0; ++y) {
+                float* row = values.data() + size_t(y) * extent.x;
+                // branch-free row reductions and bin indices
+                double sum = 0.0;
+                uint32_t active = 0;
+                for (uint32_t x = 0; x < extent.x; ++x) {
+                    const float value = std::isnan(row[x]) ? min : row[x];
+                    row[x] = value;
+                    sum += value;
+                    active += value > min ? 1 : 0;
+                    bin_ids[x] = uint32_t(glm::clamp((value - min) * bin_scale, 0.f, float(n_bins - 1)));
+                }
+                for (uint32_t x = 0; x < extent.x; ++x)
+                    histogram[bin_ids[x]]++;
+                // squared deviations from the row mean, then merged into the slice
+                const double mean = sum / extent.x;
+                double m2 = 0.0;
+                for (uint32_t x = 0; x < extent.x; ++x)
+                    m2 += (row[x] - mean) * (row[x] - mean);
+                partial_moments[z].merge(Moments{ double(extent.x), mean, m2 });
+                partial_active[z] += active;
+            }
+        }
+    });
+    // reduce
+    Moments moments;
+    for (uint32_t z = 0; z < extent.z; ++z) {
+        moments.merge(partial_moments[z]);
+        stats.n_active += partial_active[z];
+        for (size_t i = 0; i < n_bins; ++i)
+            stats.histogram[i] += partial_histograms[size_t(z) * n_bins + i];
+    }
+    stats.mean = moments.mean;
+    stats.variance = moments.m2 / stats.n_voxels;
+    return stats;
+}
+
+float GridStatistics::percentile(float p) const {
+    if (n_voxels == 0 || histogram.empty()) return min;
+    // walk the cumulative histogram and interpolate linearly within the target bin
+    const double target = glm::clamp(p, 0.f, 1.f) * double(n_voxels);
+    const float bin_width = (max - min) / histogram.size();
+    double cumulative = 0.0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        if (histogram[i] > 0 && cumulative + histogram[i] >= target) {
+            const double t = (target - cumulative) / histogram[i];
+            return min + (i + float(t)) * bin_width;
+        }
+        cumulative += histogram[i];
+    }
+    return max;
+}
+
+std::string GridStatistics::to_string(const std::string& indent) const {
+    std::stringstream out;
+    out << indent << "voxels: " << n_voxels << ", active: " << n_active << " (" << uint32_t(std::round(100 * n_active / double(std::max(n_voxels, size_t(1))))) << "%)" << std::endl;
+    out << indent << "range: [" << min << ", " << max << "]" << std::endl;
+    out << indent << "mean: " << mean << ", std dev: " << std::sqrt(variance) << std::endl;
+    out << indent << "percentiles (5/50/95/99): " << percentile(0.05f) << " / " << percentile(0.5f) << " / " << percentile(0.95f) << " / " << percentile(0.99f);
+    return out.str();
+}
+
+}
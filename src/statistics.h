@@ -0,0 +1,24 @@
+#pragma once
+
+#include "grid.h"
+
+#include <vector>
+#include <string>
+
+namespace voldata {
+
+struct GridStatistics {
+    float min, max;                             // histogram range, i.e. the grid's minorant and majorant
+    std::vector<size_t> histogram;              // voxel counts per bin, equally spaced over [min, max]
+    double mean, variance;                      // over all voxels in the index extent
+    size_t n_voxels;                            // voxels in the index extent
+    size_t n_active;                            // voxels with values above the minorant
+
+    float percentile(float p) const;            // approximate value at percentile p in [0, 1], interpolated within bins
+    std::string to_string(const std::string& indent="") const;
+};
+
+// histogram, moments and active voxel count of the whole grid in a single slice-parallel pass, NaN voxels count as the minorant
+GridStatistics compute_statistics(const Grid& grid, uint32_t bins = 256);
+
+}
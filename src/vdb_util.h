@@ -0,0 +1,56 @@
+#pragma once
+
+#include "grid.h"
+
+#include <atomic>
+#include <vector>
+#include <optional>
+#include <glm/glm.hpp>
+
+// shared helpers of the NanoVDB and OpenVDB grid wrappers
+
+namespace voldata {
+
+// unique id to key per-thread accessor caches, ids are never reused so a cache cannot outlive its grid unnoticed
+inline uint64_t next_accessor_id() {
+    static std::atomic<uint64_t> counter(1);
+    return counter++;
+}
+
+// one cached accessor per thread and accessor type, rebuilt from source whenever a different grid id or source is queried
+template <typename Accessor, typename Source> const Accessor& cached_accessor(uint64_t id, const Source& source) {
+    struct AccessorCache {
+        uint64_t id = 0;
+        const void* source = nullptr;
+        std::optional<Accessor> acc;
+    };
+    thread_local AccessorCache cache;
+    if (cache.id != id || cache.source != &source) {
+        cache.acc.emplace(source);
+        cache.id = id;
+        cache.source = &source;
+    }
+    return *cache.acc;
+}
+
+// bulk read the active blocks of grid slice-wise and call set(x, y, z, value) for voxels above its minorant
+template <typename Setter> void copy_active_voxels(const Grid& grid, const Setter& set) {
+    const float min = grid.minorant_majorant().first;
+    std::vector<float> values;
+    grid.for_each_active_block([&](const glm::uvec3& block_min, const glm::uvec3& block_max, float, float) {
+        const glm::uvec3 size = block_max - block_min;
+        values.resize(size_t(size.x) * size.y);
+        for (uint32_t z = block_min.z; z < block_max.z; ++z) {
+            grid.copy_region(glm::uvec3(block_min.x, block_min.y, z), glm::uvec3(block_max.x, block_max.y, z + 1), values.data());
+            for (uint32_t y = 0; y < size.y; ++y) {
+                for (uint32_t x = 0; x < size.x; ++x) {
+                    const float value = values[size_t(y) * size.x + x];
+                    if (value > min)
+                        set(block_min.x + x, block_min.y + y, z, value);
+                }
+            }
+        }
+    });
+}
+
+}
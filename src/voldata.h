@@ -1,11 +1,17 @@
 #pragma once
 
 #include "buf3d.h"
+#include "buffer.h"
 #include "grid.h"
 #include "grid_brick.h"
+#include "grid_brick_paged.h"
 #include "grid_dense.h"
 #include "grid_vdb.h"
 #include "grid_nvdb.h"
 #include "grid_dicom.h"
 #include "volume.h"
+#include "sampler.h"
+#include "gradient.h"
+#include "statistics.h"
+#include "quantize.h"
 #include "serialization.h"
\ No newline at end of file
@@ -63,7 +63,7 @@ size_t Volume::n_grid_frames() const {
     return grids.size();
 }
 
-Volume::GridFrame Volume::current_grid_frame() const {
+const Volume::GridFrame& Volume::current_grid_frame() const {
     return grids.at(grid_frame_counter);
 }
 
@@ -173,19 +173,17 @@ Volume::GridPtr Volume::load_grid(const std::string& filename, const std::string
         if (!raw_file.is_open())
             throw std::runtime_error("Unable to read file: " + raw_path.string());
         // parse data type and setup volume texture
-        std::vector<uint8_t> data(std::istreambuf_iterator<char>(raw_file), {});
+        raw_file.seekg(0, std::ios::end);
+        Buffer<uint8_t> data(size_t(raw_file.tellg()));
+        raw_file.seekg(0);
+        raw_file.read(reinterpret_cast<char*>(data.data()), data.size());
         std::cout << "data size bytes: " << data.size() << " / " << dim.x*dim.y*dim.z << std::endl;
         std::shared_ptr<Grid> grid;
         if (format == "UCHAR")
-            grid = std::make_shared<DenseGrid>(dim.x, dim.y, dim.z, data.data());
-        else if (format == "USHORT") {
-            // HACK: convert data to float
-            std::vector<float> data_float(data.size() / 2);
-            const uint16_t* ptr_16 = (uint16_t*)data.data();
-            for (size_t i = 0; i < data.size() / 2; ++i)
-                data_float.push_back(round(ptr_16[i] / 65535.f));
-            grid = std::make_shared<DenseGrid>(dim.x, dim.y, dim.z, data_float.data());
-        } else if (format == "FLOAT")
+            grid = std::make_shared<DenseGrid>(dim.x, dim.y, dim.z, std::move(data), DenseGrid::UINT8);
+        else if (format == "USHORT")
+            grid = std::make_shared<DenseGrid>(dim.x, dim.y, dim.z, std::move(data), DenseGrid::UINT16);
+        else if (format == "FLOAT")
             grid = std::make_shared<DenseGrid>(dim.x, dim.y, dim.z, (const float*)data.data());
         else
             throw std::runtime_error("Unsupported data format for .dat file: " + format);
@@ -264,7 +262,7 @@ Volume::GridPtr Volume::load_grid(const std::string& filename, const std::string
         grid->n_voxels = glm::uvec3(x_range.size(), y_range.size(), z_range.size());
         grid->min_value = 0.f;//meta["min_intensity"].number_value();
         grid->max_value = 1.f;//meta["max_intensity"].number_value();
-        grid->voxel_data = std::vector<uint8_t>(grid->num_voxels(), 0);
+        grid->voxel_data = Buffer<uint8_t>(grid->num_voxels(), 0);
         for (size_t i = 0; i < ply_vpos.size(); ++i) {
             const glm::vec3 pos = glm::vec3(ply_vpos[i][0], ply_vpos[i][1], ply_vpos[i][2]);
             const glm::uvec3 idx = glm::uvec3(glm::vec3(grid->n_voxels) * (pos - bb_min) / (bb_max - bb_min));
@@ -42,7 +42,7 @@ public:
     size_t n_grid_frames() const;
 
     // conveniently access the current grid frame
-    GridFrame current_grid_frame() const;                                                       // return current grid frame
+    const GridFrame& current_grid_frame() const;                                                // return current grid frame
     GridPtr current_grid(const std::string& gridname = "density") const;                        // return grid from current frame
     DenseGridPtr current_grid_dense(const std::string& gridname = "density") const;             // return grid from current frame as BrickGrid, convert if necessary
     BrickGridPtr current_grid_brick(const std::string& gridname = "density") const;             // return grid from current frame as BrickGrid, convert if necessary
@@ -0,0 +1,97 @@
+#include "test.h"
+#include "grid_dense.h"
+#include "grid_brick.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+using namespace voldata;
+
+// extent not divisible by the brick sizes, with empty space around a modulated sphere
+static const glm::uvec3 EXTENT = glm::uvec3(45, 38, 27);
+
+static DenseGrid make_source() {
+    std::vector<float> data(size_t(EXTENT.x) * EXTENT.y * EXTENT.z);
+    for (uint32_t z = 0; z < EXTENT.z; ++z)
+        for (uint32_t y = 0; y < EXTENT.y; ++y)
+            for (uint32_t x = 0; x < EXTENT.x; ++x) {
+                const float r = glm::length(glm::vec3(x, y, z) - glm::vec3(20.f, 17.f, 12.f));
+                data[(size_t(z) * EXTENT.y + y) * EXTENT.x + x] = std::max(0.f, 1.f - r / 15.f) * (0.75f + 0.25f * std::sin(0.4f * x));
+            }
+    return DenseGrid(EXTENT.x, EXTENT.y, EXTENT.z, data.data(), DenseGrid::FLOAT32);
+}
+
+// lookups match the source within the quantization error (8 bits or the tolerance, plus float16 brick ranges),
+// batched, bulk and trilinear reads agree with the lookups
+template <typename B> void check(const DenseGrid& source, const typename B::Options& options, typename B::PointerMode mode) {
+    const B grid(source, options);
+    CHECK(grid.pointer_mode == mode);
+    CHECK(grid.index_extent() == (EXTENT + B::BRICK_SIZE - 1u) / B::BRICK_SIZE * B::BRICK_SIZE);
+    const auto [min, max] = source.minorant_majorant();
+    const float bound = std::max(options.tolerance, 0.5f / 255.f * (max - min)) + 1e-3f;
+    // lookups
+    std::vector<glm::uvec3> positions;
+    std::vector<float> expected;
+    for (uint32_t z = 0; z < EXTENT.z; ++z)
+        for (uint32_t y = 0; y < EXTENT.y; ++y)
+            for (uint32_t x = 0; x < EXTENT.x; ++x) {
+                positions.push_back(glm::uvec3(x, y, z));
+                expected.push_back(grid.lookup(positions.back()));
+                CHECK(std::abs(expected.back() - source.lookup(positions.back())) <= bound);
+            }
+    // bulk read
+    std::vector<float> region(positions.size());
+    grid.copy_region(glm::uvec3(0), EXTENT, region.data());
+    CHECK(region == expected);
+    // batched lookups in random order (regrouped by brick)
+    std::mt19937 rng(7);
+    std::vector<size_t> order(positions.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<glm::uvec3> shuffled(positions.size());
+    for (size_t i = 0; i < order.size(); ++i) shuffled[i] = positions[order[i]];
+    std::vector<float> values(positions.size());
+    grid.lookup_batch(shuffled.data(), values.data(), shuffled.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        CHECK(values[i] == expected[order[i]]);
+    // trilinear samples, from a single brick with apron
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<glm::vec3> samples(1000);
+    for (auto& sample : samples)
+        sample = (glm::vec3(dist(rng), dist(rng), dist(rng)) * 0.55f + 0.5f) * glm::vec3(EXTENT);
+    std::vector<float> interpolated(samples.size());
+    grid.sample_trilinear_batch(samples.data(), interpolated.data(), samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const glm::vec3 clamped = glm::min(samples[i], glm::vec3(EXTENT) - 0.5f);
+        CHECK(std::abs(interpolated[i] - grid.sample_trilinear(samples[i])) <= 1e-5f);     // weighted sum vs. nested blends
+        CHECK(std::abs(grid.sample_trilinear(clamped) - source.sample_trilinear(clamped)) <= bound);
+    }
+}
+
+template <typename B> void check_all(const DenseGrid& source) {
+    typename B::Options options;
+    options.pointer_mode = B::PACKED;
+    check<B>(source, options, B::PACKED);
+    options.pointer_mode = B::WIDE;
+    check<B>(source, options, B::WIDE);
+    options.apron = true;
+    check<B>(source, options, B::WIDE);
+    options.pointer_mode = B::PACKED;
+    check<B>(source, options, B::PACKED);
+    options.apron = false;
+    options.deduplicate = true;
+    check<B>(source, options, B::PACKED);
+    options.pointer_mode = B::AUTO;
+    options.tolerance = 0.02f;
+    check<B>(source, options, B::VARIABLE);
+}
+
+int main() {
+    const DenseGrid source = make_source();
+    check_all<BrickGrid4>(source);
+    check_all<BrickGrid>(source);
+    check_all<BrickGrid16>(source);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#include "test.h"
+#include "grid.h"
+#include "quantize.h"
+
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace voldata;
+
+// the dispatched kernels match the scalar reference bit-exactly, ctest runs this once per VOLDATA_SIMD level
+int main() {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-0.5f, 1.5f);
+    const float specials[] = { std::numeric_limits<float>::quiet_NaN(), INFINITY, -INFINITY, FLT_MAX, -FLT_MAX, 0.f, 1.f, 0.5f / 255.f, 1.5f / 255.f };
+    const std::pair<float, float> ranges[] = { { 0.f, 1.f }, { -2.f, 3.f }, { 0.25f, 0.2500001f }, { 1.f, 1.f }, { 1.f, 0.f } };
+    // sizes around the vector widths, with unaligned starts
+    for (const size_t n : { 0, 1, 3, 4, 5, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000, 4099 }) {
+        for (const size_t offset : { 0, 1, 3 }) {
+            std::vector<float> values(n + offset);
+            for (size_t i = 0; i < values.size(); ++i)
+                values[i] = i % 7 == 3 ? specials[(i / 7) % std::size(specials)] : dist(rng);
+            const float* src = values.data() + offset;
+            // quantization
+            for (const auto& [min, max] : ranges) {
+                std::vector<uint8_t> result(n + 1, 0xAB);
+                quantize_u8_batch(src, n, min, max, result.data());
+                for (size_t i = 0; i < n; ++i)
+                    CHECK(result[i] == quantize_u8(src[i], min, max));
+                CHECK(result[n] == 0xAB);
+            }
+            // range reduction, NaNs are ignored
+            float min = FLT_MAX, max = -FLT_MAX, ref_min = FLT_MAX, ref_max = -FLT_MAX;
+            reduce_min_max(src, n, min, max);
+            for (size_t i = 0; i < n; ++i) {
+                ref_min = src[i] < ref_min ? src[i] : ref_min;
+                ref_max = src[i] > ref_max ? src[i] : ref_max;
+            }
+            CHECK(min == ref_min && max == ref_max);
+        }
+    }
+    std::printf("%s kernels ok\n", simd_level());
+    return EXIT_SUCCESS;
+}
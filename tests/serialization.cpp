@@ -0,0 +1,84 @@
+#include "test.h"
+#include "serialization.h"
+#include "grid_brick_paged.h"
+
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace voldata;
+
+// source of the baseline files: 37x29x21 voxels of max(0, 1 - r / 10) around the center,
+// stored as UINT8 DenseGrid and as default BrickGrid built from it
+static const glm::uvec3 EXTENT = glm::uvec3(37, 29, 21);
+
+static std::vector<float> baseline_data() {
+    std::vector<float> data(size_t(EXTENT.x) * EXTENT.y * EXTENT.z);
+    const glm::vec3 center = glm::vec3(EXTENT / 2u);
+    for (uint32_t z = 0; z < EXTENT.z; ++z)
+        for (uint32_t y = 0; y < EXTENT.y; ++y)
+            for (uint32_t x = 0; x < EXTENT.x; ++x)
+                data[(size_t(z) * EXTENT.y + y) * EXTENT.x + x] = std::max(0.f, 1.f - glm::length(glm::vec3(x, y, z) - center) / 10.f);
+    return data;
+}
+
+// max absolute difference of all voxel lookups
+static float max_error(const Grid& a, const Grid& b) {
+    float error = 0.f;
+    for (uint32_t z = 0; z < EXTENT.z; ++z)
+        for (uint32_t y = 0; y < EXTENT.y; ++y)
+            for (uint32_t x = 0; x < EXTENT.x; ++x)
+                error = std::max(error, std::abs(a.lookup(glm::uvec3(x, y, z)) - b.lookup(glm::uvec3(x, y, z))));
+    return error;
+}
+
+int main(int argc, char** argv) {
+    CHECK(argc > 1);
+    const fs::path data_dir = argv[1];
+    const std::vector<float> data = baseline_data();
+    const DenseGrid source(EXTENT.x, EXTENT.y, EXTENT.z, data.data(), DenseGrid::FLOAT32);
+
+    // files without header load with the implicit defaults of version 0
+    auto dense = load_dense_grid(data_dir / "baseline.dense");
+    CHECK(dense->format == DenseGrid::UINT8 && dense->layout == DenseGrid::LINEAR);
+    CHECK(dense->index_extent() == EXTENT);
+    CHECK(max_error(*dense, source) <= 0.5f / 255.f + 1e-6f);
+    auto brick = load_brick_grid(data_dir / "baseline.brick");
+    CHECK(brick->pointer_mode == BrickGrid::PACKED && brick->apron == 0 && brick->dilation == 2);
+    CHECK(!brick->range_mipmaps.empty() && brick->range_mipmaps.back().size() == glm::uvec3(1));
+    CHECK(max_error(*brick, source) < 1e-2f);
+    PagedBrickGrid paged(data_dir / "baseline.brick");
+    CHECK(max_error(paged, *brick) == 0.f);
+
+    // round trip in the current format
+    write_grid(dense, "roundtrip.dense");
+    auto dense_rt = load_dense_grid("roundtrip.dense");
+    CHECK(dense_rt->voxel_data == dense->voxel_data && dense_rt->min_value == dense->min_value && dense_rt->max_value == dense->max_value);
+    write_grid(brick, "roundtrip.brick");
+    auto brick_rt = load_brick_grid("roundtrip.brick");
+    CHECK(brick_rt->indirection.data == brick->indirection.data && brick_rt->range.data == brick->range.data && brick_rt->atlas.data == brick->atlas.data);
+    CHECK(max_error(*brick_rt, *brick) == 0.f);
+
+    // fields of newer versions: dense format and layout, brick apron, dilation and sparsity threshold
+    auto tiled = std::make_shared<DenseGrid>(source, DenseGrid::FLOAT16, DenseGrid::TILED);
+    write_grid(tiled, "tiled.dense");
+    auto tiled_rt = load_dense_grid("tiled.dense");
+    CHECK(tiled_rt->format == DenseGrid::FLOAT16 && tiled_rt->layout == DenseGrid::TILED && tiled_rt->voxel_data == tiled->voxel_data);
+    CHECK(max_error(*tiled_rt, *tiled) == 0.f);
+    BrickGrid::Options options;
+    options.apron = true;
+    options.dilation = 3;
+    options.sparsity_threshold = 0.1f;
+    auto apron = std::make_shared<BrickGrid>(source, options);
+    write_grid(apron, "apron.brick");
+    auto apron_rt = load_brick_grid("apron.brick");
+    CHECK(apron_rt->apron == 1 && apron_rt->dilation == 3 && apron_rt->sparsity_threshold == 0.1f && apron_rt->atlas.data == apron->atlas.data);
+    CHECK(max_error(*apron_rt, *apron) == 0.f);
+    CHECK(max_error(PagedBrickGrid("apron.brick"), *apron) == 0.f);
+
+    // grids of a different brick size are rejected
+    bool rejected = false;
+    try { load_brick_grid<2>("roundtrip.brick"); } catch (const std::runtime_error&) { rejected = true; }
+    CHECK(rejected);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// minimal check for the test executables, prints the failed condition and exits with an error
+#define CHECK(cond) do { if (!(cond)) { std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); std::exit(EXIT_FAILURE); } } while (0)
@@ -17,11 +17,15 @@ std::pair<float, float> benchmark_grid(const std::shared_ptr<voldata::Grid>& gri
     std::for_each(std::execution::par_unseq, slices.begin(), slices.end(),
     [&](uint32_t z)
     {
-        for (uint32_t y = 0; y < n_voxels.y; ++y)
-            for (uint32_t x = 0; x < n_voxels.x; ++x) {
-                const float value = grid->lookup(glm::ivec3(x, y, z));
+        std::vector<glm::uvec3> positions(n_voxels.x);
+        std::vector<float> values(n_voxels.x);
+        for (uint32_t y = 0; y < n_voxels.y; ++y) {
+            for (uint32_t x = 0; x < n_voxels.x; ++x)
+                positions[x] = glm::uvec3(x, y, z);
+            grid->lookup_batch(positions.data(), values.data(), n_voxels.x);
+            for (const float value : values)
                 partial_sums[z] += value * norm_f;
-            }
+        }
     });
     // reduce
     float average = 0.f;
@@ -44,6 +48,13 @@ int main(int argc, char** argv) {
     auto end_load = std::chrono::system_clock::now();
     std::cout << volume->to_string("\t") << std::endl;
 
+    std::cout << "------------------------------------" << std::endl;
+    std::cout << "Statistics:" << std::endl;
+    auto start_stats = std::chrono::system_clock::now();
+    const voldata::GridStatistics stats = voldata::compute_statistics(*volume->current_grid());
+    auto end_stats = std::chrono::system_clock::now();
+    std::cout << stats.to_string("\t") << std::endl;
+
     std::cout << "------------------------------------" << std::endl;
     std::cout << "Dense grid:" << std::endl;
     auto start_dense = std::chrono::system_clock::now();
@@ -76,6 +87,7 @@ int main(int argc, char** argv) {
 
     std::cout << "------------------------------------" << std::endl;
     std::cout << "Loading took " << (end_load - start_load).count() / 1000000 << "ms." << std::endl;
+    std::cout << "Statistics pass took " << (end_stats - start_stats).count() / 1000000 << "ms." << std::endl;
     std::cout << "Dense grid conversion took " << (end_dense - start_dense).count() / 1000000 << "ms." << std::endl;
     std::cout << "Brick grid conversion took " << (end_brick - start_brick).count() / 1000000 << "ms." << std::endl;
 #ifdef VOLDATA_WITH_OPENVDB